@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "NearestCentroid.hpp"
+#include "PointSet.hpp"
+#include "ThreadPool.hpp"
+
+class KdTree;
+
+enum class ClusteringAlgorithm { Lloyd, Hamerly, Elkan, Yinyang, KdTree };
+
+struct ClusterAccumulator {
+  double r = 0.0;
+  double g = 0.0;
+  double b = 0.0;
+  double weight = 0.0;
+  // Weighted sum of squared norms, gives the inertia around the mean without another pass
+  double squares = 0.0;
+};
+
+// One vector of per-cluster accumulators for every thread of the pool
+using ThreadAccumulators = std::vector<std::vector<ClusterAccumulator>>;
+
+// Assignment step of k-means. Engines differ in how they find the closest centroid, but all of
+// them must produce exactly the assignments of the brute force search.
+class ClusteringEngine {
+ public:
+  ClusteringEngine(const PointSet& points, ThreadPool& thread_pool)
+      : points_(points),
+        thread_pool_(thread_pool),
+        thread_moved_counts_(thread_pool.num_threads(), 0) {}
+  virtual ~ClusteringEngine() = default;
+
+  // Returned by engines that gather cluster sums without tracking per-point assignments
+  static constexpr size_t kUnknownMovedCount = static_cast<size_t>(-1);
+
+  // Assigns every point to its closest centroid and gathers per-cluster sums in the same sweep.
+  // Accumulators have to be zeroed by the caller. Returns the number of points whose cluster
+  // differs from the one found in assignments on entry, or kUnknownMovedCount.
+  virtual size_t assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                        ThreadAccumulators& thread_accumulators) = 0;
+
+ protected:
+  void accumulate(std::vector<ClusterAccumulator>& accumulators, const size_t point_idx,
+                  const uint32_t cluster_idx) const {
+    accumulate(accumulators, point_idx, points_.c0()[point_idx], points_.c1()[point_idx],
+               points_.c2()[point_idx], cluster_idx);
+  }
+
+  // Same for a point whose components were loaded already, e.g. widened from halves
+  void accumulate(std::vector<ClusterAccumulator>& accumulators, const size_t point_idx,
+                  const float c0, const float c1, const float c2,
+                  const uint32_t cluster_idx) const {
+    auto& accumulator = accumulators[cluster_idx];
+    const auto weight = points_.weight(point_idx);
+    accumulator.r += weight * c0;
+    accumulator.g += weight * c1;
+    accumulator.b += weight * c2;
+    accumulator.weight += weight;
+    accumulator.squares += weight * squared_norm(c0, c1, c2);
+  }
+
+  static double squared_norm(const double c0, const double c1, const double c2) {
+    return c0 * c0 + c1 * c1 + c2 * c2;
+  }
+
+  // Bounds are maintained in floating point, so they are only trusted when they prune by a margin
+  // larger than the rounding error. Otherwise the distance is evaluated and compared exactly as in
+  // the brute force search.
+  static bool definitely_closer(const float distance, const float bound) {
+    return distance * 1.0001f + 1e-6f < bound;
+  }
+
+  size_t total_moved_count() const {
+    size_t moved = 0;
+    for (const auto thread_moved : thread_moved_counts_) {
+      moved += thread_moved;
+    }
+
+    return moved;
+  }
+
+  const PointSet& points_;
+  ThreadPool& thread_pool_;
+
+  // Filled by the threads of the pool, entries of threads without work are left untouched
+  std::vector<size_t> thread_moved_counts_;
+};
+
+// kd_tree is only used by the kd-tree engine, which builds its own when none is passed
+std::unique_ptr<ClusteringEngine> make_clustering_engine(
+    const ClusteringAlgorithm algorithm, const PointSet& points, ThreadPool& thread_pool,
+    std::shared_ptr<const KdTree> kd_tree = nullptr);
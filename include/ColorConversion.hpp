@@ -0,0 +1,437 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+enum class ColorSpace { sRGB, sRGBLinear, rgG, XYZ, OKLAB };
+
+// Color conversions with the source and the target color space as template parameters. Every
+// conversion goes through linear sRGB: the source is decoded up to its last linear stage, the
+// matrices on both sides of linear sRGB are multiplied into one at compile time and the target's
+// nonlinear stages finish the job. Identity matrices are skipped, so e.g. sRGB to OKLAB costs the
+// same as the hand written pipeline and XYZ to OKLAB saves a matrix. The stages are generic over
+// the component type, the batch conversions below instantiate them for SIMD vectors.
+
+// Fast conversions replace the cube root of OKLAB by cube_root_fast()
+enum class ConversionAccuracy { Accurate, Fast };
+
+inline float srgb_encode(const float c) {
+  const float y = 1.0f / 2.4f;
+
+  if (c <= 0.0031308f)
+    return c * 12.92f;
+  else
+    return 1.055f * std::pow(c, y) - 0.055f;
+}
+
+inline float srgb_decode(const float c) {
+  if (c <= 0.04045f)
+    return c / 12.92f;
+  else
+    return std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float cube_root(const float c) { return std::cbrtf(c); }
+
+// Cube root from a bit level estimate and two Newton steps. The estimate divides the exponent by
+// three and is within 3.2%, each step squares the relative error. Differs from std::cbrtf by at
+// most 1.8e-6 relative for normal inputs, far below the distances that decide assignments.
+inline float cube_root_fast(const float c) {
+  uint32_t bits;
+  std::memcpy(&bits, &c, sizeof(bits));
+
+  const auto magnitude = bits & 0x7FFFFFFFu;
+  if (magnitude == 0) {
+    return c;
+  }
+
+  float a;
+  std::memcpy(&a, &magnitude, sizeof(a));
+
+  // Floats this large are integers, the conversion back is exact
+  const auto estimate_bits =
+      static_cast<uint32_t>(static_cast<float>(magnitude) * (1.0f / 3.0f) + 709921077.0f);
+  float y;
+  std::memcpy(&y, &estimate_bits, sizeof(y));
+
+  for (int step = 0; step < 2; ++step) {
+    y = (1.0f / 3.0f) * (y + y + a / (y * y));
+  }
+
+  return bits & 0x80000000u ? -y : y;
+}
+
+// Natural logarithm and exponential function evaluated at compile time, accurate to about double
+// precision for the positive, moderate arguments of the tables below
+constexpr double constexpr_log(double x) {
+  constexpr double kLn2 = 0.6931471805599453;
+
+  int exponent = 0;
+  while (x >= 1.0) {
+    x *= 0.5;
+    ++exponent;
+  }
+  while (x < 0.5) {
+    x *= 2.0;
+    --exponent;
+  }
+
+  // ln(x) = 2 atanh(t) with |t| <= 1/3
+  const auto t = (x - 1.0) / (x + 1.0);
+  double term = t;
+  double sum = 0.0;
+  for (int k = 1; k < 40; k += 2) {
+    sum += term / k;
+    term *= t * t;
+  }
+
+  return 2.0 * sum + exponent * kLn2;
+}
+
+constexpr double constexpr_exp(const double x) {
+  constexpr double kLn2 = 0.6931471805599453;
+
+  auto exponent = static_cast<int>(x / kLn2 + (x < 0.0 ? -0.5 : 0.5));
+  const auto r = x - exponent * kLn2;
+
+  double term = 1.0;
+  double sum = 1.0;
+  for (int k = 1; k < 24; ++k) {
+    term *= r / k;
+    sum += term;
+  }
+
+  for (; exponent > 0; --exponent) {
+    sum *= 2.0;
+  }
+  for (; exponent < 0; ++exponent) {
+    sum *= 0.5;
+  }
+
+  return sum;
+}
+
+// srgb_decode(value / 255.0f) for every 8-bit value. The power is evaluated in double precision
+// and rounded once, which gives the same floats as std::pow.
+constexpr std::array<float, 256> make_srgb_decode_table() {
+  std::array<float, 256> table{};
+
+  for (int value = 0; value < 256; ++value) {
+    const auto c = value / 255.0f;
+
+    if (c <= 0.04045f) {
+      table[value] = c / 12.92f;
+    } else {
+      const double base = (c + 0.055f) / 1.055f;
+      table[value] = static_cast<float>(constexpr_exp(2.4f * constexpr_log(base)));
+    }
+  }
+
+  return table;
+}
+
+inline constexpr auto kSrgbDecodeTable = make_srgb_decode_table();
+
+// Linear values from which 8-bit sRGB values round up to the next one: the smallest float not
+// below the linear value of (value + 0.5) / 255. The last entry lies above every clamped input.
+constexpr std::array<float, 256> make_srgb_encode_thresholds() {
+  std::array<float, 256> thresholds{};
+
+  for (int value = 0; value < 255; ++value) {
+    const auto c = (value + 0.5) / 255.0;
+    const auto linear =
+        c <= 0.04045 ? c / 12.92 : constexpr_exp(2.4 * constexpr_log((c + 0.055) / 1.055));
+
+    auto threshold = static_cast<float>(linear);
+    if (threshold < linear) {
+      // One ulp up, the thresholds are normal floats below one
+      auto power_of_two = 1.0f;
+      while (power_of_two > threshold) {
+        power_of_two *= 0.5f;
+      }
+      threshold += power_of_two * (1.0f / (1 << 23));
+    }
+
+    thresholds[value] = threshold;
+  }
+
+  thresholds[255] = 2.0f;
+  return thresholds;
+}
+
+inline constexpr auto kSrgbEncodeThresholds = make_srgb_encode_thresholds();
+
+// 8-bit sRGB value of the linear value bin / 4096 for every bin. Bins are narrower than the gaps
+// between thresholds, so every value in a bin encodes to its entry or the next one. Three padding
+// bytes allow 32-bit gathers of the last entry.
+constexpr size_t kSrgbEncodeBins = 4096;
+
+constexpr std::array<uint8_t, kSrgbEncodeBins + 3> make_srgb_encode_table() {
+  std::array<uint8_t, kSrgbEncodeBins + 3> table{};
+
+  int value = 0;
+  for (size_t bin = 0; bin < kSrgbEncodeBins; ++bin) {
+    const auto linear = static_cast<float>(bin) / kSrgbEncodeBins;
+    while (linear >= kSrgbEncodeThresholds[value]) {
+      ++value;
+    }
+    table[bin] = static_cast<uint8_t>(value);
+  }
+
+  return table;
+}
+
+inline constexpr auto kSrgbEncodeTable = make_srgb_encode_table();
+
+// A linear sRGB value encoded to 8-bit sRGB and rounded to nearest, without evaluating the power.
+// Values outside of [0, 1] are clamped, NaNs become zero.
+inline uint8_t encode_srgb8(const float value) {
+  const auto clamped = std::min(1.0f, std::max(0.0f, value));
+  const auto bin = std::min(static_cast<size_t>(clamped * kSrgbEncodeBins), kSrgbEncodeBins - 1);
+
+  const auto encoded = kSrgbEncodeTable[bin];
+  return clamped >= kSrgbEncodeThresholds[encoded] ? static_cast<uint8_t>(encoded + 1) : encoded;
+}
+
+// A value in [0, 1] scaled to 8 bits and rounded to nearest, clamped like encode_srgb8()
+inline uint8_t pack_unorm8(const float value) {
+  return static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, 255.0f * value + 0.5f)));
+}
+
+struct ColorMatrix {
+  float m[3][3];
+
+  static constexpr ColorMatrix identity() {
+    return ColorMatrix{{{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}};
+  }
+
+  constexpr bool isIdentity() const {
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 3; ++column) {
+        if (m[row][column] != (row == column ? 1.0f : 0.0f)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Applies other first, then this matrix. Products with the identity are exact.
+  constexpr ColorMatrix operator*(const ColorMatrix& other) const {
+    ColorMatrix result{};
+    for (int row = 0; row < 3; ++row) {
+      for (int column = 0; column < 3; ++column) {
+        result.m[row][column] = m[row][0] * other.m[0][column] + m[row][1] * other.m[1][column] +
+                                m[row][2] * other.m[2][column];
+      }
+    }
+    return result;
+  }
+
+  template <typename T>
+  void apply(T& c0, T& c1, T& c2) const {
+    const auto x = m[0][0] * c0 + m[0][1] * c1 + m[0][2] * c2;
+    const auto y = m[1][0] * c0 + m[1][1] * c1 + m[1][2] * c2;
+    const auto z = m[2][0] * c0 + m[2][1] * c1 + m[2][2] * c2;
+
+    c0 = x;
+    c1 = y;
+    c2 = z;
+  }
+};
+
+// Per color space: decode() runs the stages before the final matrix to linear sRGB, kToLinear,
+// and encode() the stages after the first matrix from linear sRGB, kFromLinear.
+template <ColorSpace color_space>
+struct ColorSpaceTraits;
+
+template <>
+struct ColorSpaceTraits<ColorSpace::sRGB> {
+  static constexpr ColorMatrix kToLinear = ColorMatrix::identity();
+  static constexpr ColorMatrix kFromLinear = ColorMatrix::identity();
+
+  template <typename T>
+  static void decode(T& c0, T& c1, T& c2) {
+    c0 = srgb_decode(c0);
+    c1 = srgb_decode(c1);
+    c2 = srgb_decode(c2);
+  }
+
+  template <ConversionAccuracy accuracy, typename T>
+  static void encode(T& c0, T& c1, T& c2) {
+    c0 = srgb_encode(c0);
+    c1 = srgb_encode(c1);
+    c2 = srgb_encode(c2);
+  }
+};
+
+template <>
+struct ColorSpaceTraits<ColorSpace::sRGBLinear> {
+  static constexpr ColorMatrix kToLinear = ColorMatrix::identity();
+  static constexpr ColorMatrix kFromLinear = ColorMatrix::identity();
+
+  template <typename T>
+  static void decode(T&, T&, T&) {}
+  template <ConversionAccuracy accuracy, typename T>
+  static void encode(T&, T&, T&) {}
+};
+
+template <>
+struct ColorSpaceTraits<ColorSpace::rgG> {
+  static constexpr ColorMatrix kToLinear = ColorMatrix::identity();
+  static constexpr ColorMatrix kFromLinear = ColorMatrix::identity();
+
+  template <typename T>
+  static void decode(T& c0, T& c1, T& c2) {
+    // Confusing bit because b = G
+    const auto factor = c2 / c1;
+    const auto r = c0 * factor;
+    const auto g = c2;
+    const auto b = (1.0f - c0 - c1) * factor;
+
+    c0 = r;
+    c1 = g;
+    c2 = b;
+  }
+
+  template <ConversionAccuracy accuracy, typename T>
+  static void encode(T& c0, T& c1, T& c2) {
+    const auto normalizing_factor = 1.0f / (c0 + c1 + c2 + 0.0001f);
+    const auto g = c1;
+
+    c0 *= normalizing_factor;
+    c1 *= normalizing_factor;
+    c2 = g;
+  }
+};
+
+template <>
+struct ColorSpaceTraits<ColorSpace::XYZ> {
+  static constexpr ColorMatrix kToLinear{
+      {{3.240812398895283f, -1.5373084456298136f, -0.4985865229069666f},
+       {-0.9692430170086407f, 1.8759663029085742f, 0.04155503085668564f},
+       {0.055638398436112804f, -0.20400746093241362f, 1.0571295702861434f}}};
+  static constexpr ColorMatrix kFromLinear{
+      {{0.4124108464885388f, 0.3575845678529519f, 0.18045380393360833f},
+       {0.21264934272065283f, 0.7151691357059038f, 0.07218152157344333f},
+       {0.019331758429150258f, 0.11919485595098397f, 0.9503900340503373f}}};
+
+  template <typename T>
+  static void decode(T&, T&, T&) {}
+  template <ConversionAccuracy accuracy, typename T>
+  static void encode(T&, T&, T&) {}
+};
+
+// https://bottosson.github.io/posts/oklab/
+template <>
+struct ColorSpaceTraits<ColorSpace::OKLAB> {
+  // From LMS after the cube
+  static constexpr ColorMatrix kToLinear{{{4.0767416621f, -3.3077115913f, 0.2309699292f},
+                                          {-1.2684380046f, 2.6097574011f, -0.3413193965f},
+                                          {-0.0041960863f, -0.7034186147f, 1.7076147010f}}};
+  // To LMS before the cube root
+  static constexpr ColorMatrix kFromLinear{{{0.4122214708f, 0.5363325363f, 0.0514459929f},
+                                            {0.2119034982f, 0.6806995451f, 0.1073969566f},
+                                            {0.0883024619f, 0.2817188376f, 0.6299787005f}}};
+  static constexpr ColorMatrix kLabToLms{{{1.0f, 0.3963377774f, 0.2158037573f},
+                                          {1.0f, -0.1055613458f, -0.0638541728f},
+                                          {1.0f, -0.0894841775f, -1.2914855480f}}};
+  static constexpr ColorMatrix kLmsToLab{{{0.2104542553f, 0.7936177850f, -0.0040720468f},
+                                          {1.9779984951f, -2.4285922050f, 0.4505937099f},
+                                          {0.0259040371f, 0.7827717662f, -0.8086757660f}}};
+
+  template <typename T>
+  static void decode(T& c0, T& c1, T& c2) {
+    kLabToLms.apply(c0, c1, c2);
+    c0 = c0 * c0 * c0;
+    c1 = c1 * c1 * c1;
+    c2 = c2 * c2 * c2;
+  }
+
+  template <ConversionAccuracy accuracy, typename T>
+  static void encode(T& c0, T& c1, T& c2) {
+    if constexpr (accuracy == ConversionAccuracy::Fast) {
+      c0 = cube_root_fast(c0);
+      c1 = cube_root_fast(c1);
+      c2 = cube_root_fast(c2);
+    } else {
+      c0 = cube_root(c0);
+      c1 = cube_root(c1);
+      c2 = cube_root(c2);
+    }
+    kLmsToLab.apply(c0, c1, c2);
+  }
+};
+
+// Straight line conversion of one color's components from one color space to another
+template <ColorSpace from, ColorSpace to,
+          ConversionAccuracy accuracy = ConversionAccuracy::Accurate, typename T = float>
+inline void convert(T& c0, T& c1, T& c2) {
+  if constexpr (from != to) {
+    using Source = ColorSpaceTraits<from>;
+    using Target = ColorSpaceTraits<to>;
+
+    Source::decode(c0, c1, c2);
+
+    constexpr auto matrix = Target::kFromLinear * Source::kToLinear;
+    if constexpr (!matrix.isIdentity()) {
+      matrix.apply(c0, c1, c2);
+    }
+
+    Target::template encode<accuracy>(c0, c1, c2);
+  }
+}
+
+// Calls function with std::integral_constant<ColorSpace, color_space>, so a loop inside it can be
+// specialized for a color space known only at runtime with a single branch outside of it
+template <typename Function>
+decltype(auto) dispatch_color_space(const ColorSpace color_space, Function&& function) {
+  switch (color_space) {
+    case ColorSpace::sRGB:
+      return function(std::integral_constant<ColorSpace, ColorSpace::sRGB>{});
+    case ColorSpace::sRGBLinear:
+      return function(std::integral_constant<ColorSpace, ColorSpace::sRGBLinear>{});
+    case ColorSpace::rgG:
+      return function(std::integral_constant<ColorSpace, ColorSpace::rgG>{});
+    case ColorSpace::XYZ:
+      return function(std::integral_constant<ColorSpace, ColorSpace::XYZ>{});
+    case ColorSpace::OKLAB:
+      return function(std::integral_constant<ColorSpace, ColorSpace::OKLAB>{});
+    default:
+      throw std::runtime_error("Unsupported target color space!");
+  }
+}
+
+using ColorConverter = void (*)(float& c0, float& c1, float& c2);
+
+// The specialized conversion for a pair of color spaces known only at runtime
+inline ColorConverter color_converter(const ColorSpace from, const ColorSpace to) {
+  return dispatch_color_space(from, [to](auto source) {
+    return dispatch_color_space(to, [](auto target) -> ColorConverter {
+      return &convert<decltype(source)::value, decltype(target)::value>;
+    });
+  });
+}
+
+// Batch conversions of count colors, vectorized with AVX2 or SSE2. The vector transfer functions
+// and cube root differ from std::pow and std::cbrtf by less than 1e-6 relative, for positive
+// normal inputs. Every color goes through the vector code, also the ones of a partial last vector,
+// so its result does not depend on its position. Planar components are converted in place.
+void convert_colors(const ColorSpace from, const ColorSpace to, float* c0, float* c1, float* c2,
+                    const size_t count,
+                    const ConversionAccuracy accuracy = ConversionAccuracy::Accurate);
+// Interleaved components, e.g. rows of an image, converted into planar ones
+void convert_colors(const ColorSpace from, const ColorSpace to, const float* interleaved,
+                    const size_t count, float* c0, float* c1, float* c2,
+                    const ConversionAccuracy accuracy = ConversionAccuracy::Accurate);
+
+// Batch versions of encode_srgb8() and pack_unorm8() for image output, vectorized with AVX2 and
+// (packing only) SSE2
+void encode_srgb8(const float* values, const size_t count, uint8_t* bytes);
+void pack_unorm8(const float* values, const size_t count, uint8_t* bytes);
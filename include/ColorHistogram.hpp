@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Color.hpp"
+#include "Image.hpp"
+
+// Histogram of 8-bit sRGB colors, filled while an image is being loaded. With 8 bits per channel
+// every distinct color gets its own bin. With fewer bits colors are binned into a coarser
+// 2^(3 * bits) grid and each bin is represented by the mean color of its pixels.
+class ColorHistogram : public PixelSink {
+ public:
+  ColorHistogram(const unsigned int bits_per_channel, const bool skip_black);
+
+  void consume(const unsigned char* rgb, const size_t num_pixels) override;
+  void finish() override;
+
+  size_t size() const { return colors_.size(); }
+  bool empty() const { return colors_.empty(); }
+
+  // Color of a bin in (gamma compressed) sRGB
+  const Color& getColor(const size_t index) const { return colors_[index]; }
+  uint32_t getCount(const size_t index) const { return counts_[index]; }
+
+  uint64_t getTotalCount() const { return total_count_; }
+
+  // With 8 bits per channel every bin holds an exact 8-bit color
+  unsigned int getBitsPerChannel() const { return bits_per_channel_; }
+
+ private:
+  uint32_t bin_index(const unsigned char r, const unsigned char g, const unsigned char b) const {
+    const auto shift = 8 - bits_per_channel_;
+    return ((r >> shift) << (2 * bits_per_channel_)) | ((g >> shift) << bits_per_channel_) |
+           (b >> shift);
+  }
+
+  unsigned int bits_per_channel_;
+  bool skip_black_;
+
+  // Dense tables over the whole grid, released by finish()
+  std::vector<uint32_t> bin_counts_;
+  // Per-channel sums of the binned 8-bit values, not needed when every color has its own bin
+  std::vector<uint64_t> bin_sums_;
+
+  std::vector<Color> colors_;
+  std::vector<uint32_t> counts_;
+  uint64_t total_count_;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include "PointSet.hpp"
+#include "RNG.hpp"
+#include "ThreadPool.hpp"
+
+// Weighted coreset by sensitivity sampling (Feldman and Langberg, in the form of Bachem, Lucic and
+// Krause). A k-means++ solution with num_clusters centers bounds how much every color can
+// contribute to the cost of any solution; coreset_size colors are drawn with probability
+// proportional to that bound and reweighted so that costs stay unbiased. With enough samples,
+// growing as k log k / eps^2, the k-means cost of any set of centers on the coreset is within a
+// factor of (1 +- eps) of its cost on all colors with high probability. The coreset is stored like
+// points.
+PointSet build_coreset(const PointSet& points, const size_t num_clusters,
+                       const size_t coreset_size, RNG& rng, ThreadPool& thread_pool);
+
+// Text file with one "r g b weight" line per color in sRGB, so it can be clustered again in any
+// color space and with any storage. Returns false when the file can't be written.
+bool save_coreset(const PointSet& coreset, const std::string& filename);
+std::optional<PointSet> load_coreset(const std::string& filename, const ColorSpace color_space,
+                                     const PointStorage storage = PointStorage::Float32);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ClusteringEngine.hpp"
+
+// Elkan's algorithm: keeps an upper bound and one lower bound per centroid for every point, along
+// with all pairwise centroid distances. Prunes more distance evaluations than Hamerly's algorithm
+// at the cost of storing num_points * num_clusters bounds.
+class ElkanEngine : public ClusteringEngine {
+ public:
+  ElkanEngine(const PointSet& points, ThreadPool& thread_pool);
+
+  size_t assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                ThreadAccumulators& thread_accumulators) override;
+
+ private:
+  size_t initialize_bounds(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                           ThreadAccumulators& thread_accumulators);
+
+  std::vector<float> upper_bounds_;
+  std::vector<float> lower_bounds_;
+  std::vector<float> half_centroid_distances_;
+  std::vector<float> half_separations_;
+  CentroidSet previous_centroids_;
+  bool initialized_;
+};
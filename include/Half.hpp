@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 binary16 conversions. Rounding is to nearest even, the same as the F16C instructions
+// with the default rounding mode, so values packed here decode identically in the SIMD kernels.
+
+inline uint16_t float_to_half(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+  const auto magnitude = bits & 0x7FFFFFFFu;
+
+  // Infinity and NaN, NaNs stay quiet
+  if (magnitude >= 0x7F800000u) {
+    return sign | 0x7C00u | (magnitude > 0x7F800000u ? 0x200u : 0u);
+  }
+
+  // 65520 and above round to infinity
+  if (magnitude >= 0x477FF000u) {
+    return sign | 0x7C00u;
+  }
+
+  // Below 2^-14 the result is subnormal, the implicit bit is shifted into the mantissa
+  if (magnitude < 0x38800000u) {
+    const auto shift = 126u - (magnitude >> 23);
+    if (shift > 24u) {
+      return sign;
+    }
+
+    const auto mantissa = (magnitude & 0x7FFFFFu) | 0x800000u;
+    auto result = mantissa >> shift;
+    const auto remainder = mantissa & ((1u << shift) - 1u);
+    const auto halfway = 1u << (shift - 1u);
+
+    if (remainder > halfway || (remainder == halfway && (result & 1u))) {
+      ++result;
+    }
+
+    return sign | static_cast<uint16_t>(result);
+  }
+
+  // Rebias the exponent and round away the low 13 mantissa bits, a carry correctly bumps the
+  // exponent
+  auto result = (magnitude - 0x38000000u) >> 13;
+  const auto remainder = magnitude & 0x1FFFu;
+
+  if (remainder > 0x1000u || (remainder == 0x1000u && (result & 1u))) {
+    ++result;
+  }
+
+  return sign | static_cast<uint16_t>(result);
+}
+
+inline float half_to_float(const uint16_t value) {
+  const auto sign = static_cast<uint32_t>(value & 0x8000u) << 16;
+  auto exponent = static_cast<uint32_t>((value >> 10) & 0x1Fu);
+  auto mantissa = static_cast<uint32_t>(value & 0x3FFu);
+
+  uint32_t bits;
+  if (exponent == 0x1Fu) {
+    bits = sign | 0x7F800000u | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Subnormal, normalized for the wider exponent range of float
+    exponent = 113;
+    while (!(mantissa & 0x400u)) {
+      mantissa <<= 1;
+      --exponent;
+    }
+
+    bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+  }
+
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+// Table lookup version of half_to_float for scalar loops, e.g. the tails of the SIMD conversions
+// and builds without SSE2. The table takes 256 KiB.
+inline float half_to_float_fast(const uint16_t value) {
+  static const auto table = [] {
+    std::array<float, 65536> values;
+    for (uint32_t half = 0; half < values.size(); ++half) {
+      values[half] = half_to_float(static_cast<uint16_t>(half));
+    }
+    return values;
+  }();
+
+  return table[value];
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ClusteringEngine.hpp"
+
+// Hamerly's algorithm: keeps an upper bound on the distance to the assigned centroid and a single
+// lower bound on the distance to any other centroid per point. Points whose bounds prove that the
+// assignment can't change are skipped without evaluating any distance.
+class HamerlyEngine : public ClusteringEngine {
+ public:
+  HamerlyEngine(const PointSet& points, ThreadPool& thread_pool);
+
+  size_t assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                ThreadAccumulators& thread_accumulators) override;
+
+ private:
+  size_t initialize_bounds(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                           ThreadAccumulators& thread_accumulators);
+
+  std::vector<float> upper_bounds_;
+  std::vector<float> lower_bounds_;
+  std::vector<float> half_separations_;
+  CentroidSet previous_centroids_;
+  bool initialized_;
+};
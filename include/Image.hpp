@@ -5,10 +5,24 @@
 
 #include "Color.hpp"
 
+// Receives the decoded 8-bit RGB data of an image while it is being loaded
+class PixelSink {
+ public:
+  virtual ~PixelSink() = default;
+
+  virtual void consume(const unsigned char* rgb, const size_t num_pixels) = 0;
+  // Called once all pixels were consumed
+  virtual void finish() {}
+};
+
+// Pixels are stored in sRGB, or in linear sRGB for images loaded with that color space
 class Image {
  public:
-  Image(const std::string& filename);
-  Image(unsigned int width, unsigned int height);
+  // Loading into ColorSpace::sRGBLinear decodes every 8-bit component with a single table lookup
+  Image(const std::string& filename, PixelSink* sink = nullptr,
+        const ColorSpace color_space = ColorSpace::sRGB);
+  // Blank image, linear ones are encoded to sRGB by save()
+  Image(unsigned int width, unsigned int height, const ColorSpace color_space = ColorSpace::sRGB);
 
   Image(const Image& other);
   Image(Image&& other);
@@ -22,6 +36,7 @@ class Image {
 
   unsigned int getWidth() const { return width_; }
   unsigned int getHeight() const { return height_; }
+  ColorSpace getColorSpace() const { return color_space_; }
 
   inline Color getPixel(unsigned int x, unsigned int y) const;
   inline void setPixel(unsigned int x, unsigned int y, const Color& color);
@@ -29,6 +44,9 @@ class Image {
   Image& operator=(const Image& other);
   Image& operator=(Image&& other);
 
+  // Interleaved r, g, b components, row by row
+  const float* getData() const { return pixels_.get(); }
+
   float operator[](unsigned int index) const { return pixels_[index]; }
   float& operator[](unsigned int index) { return pixels_[index]; }
 
@@ -36,13 +54,14 @@ class Image {
   unsigned int width_;
   unsigned int height_;
   unsigned int len_;
+  ColorSpace color_space_;
   std::unique_ptr<float[]> pixels_;
 };
 
 Color Image::getPixel(unsigned int x, unsigned int y) const {
   const int index = 3 * (y * width_ + x);
 
-  Color c;
+  Color c{color_space_};
   c.r = pixels_[index];
   c.g = pixels_[index + 1];
   c.b = pixels_[index + 2];
@@ -1,29 +1,86 @@
 #pragma once
 
 #include <functional>
+#include <memory>
+#include <optional>
 #include <random>
 #include <vector>
 
+#include "ClusteringEngine.hpp"
 #include "Color.hpp"
-#include "Image.hpp"
+#include "NearestCentroid.hpp"
+#include "PointSet.hpp"
 #include "RNG.hpp"
+#include "Seeding.hpp"
+#include "ThreadPool.hpp"
 
 class KMeansClustering {
  public:
-  KMeansClustering(RNG& rng, const Image& image, const size_t num_clusters,
-                   const ColorSpace color_space, const bool skip_black);
+  // Colors are shared read-only, so several clusterings can run concurrently on the same set. So
+  // can a kd-tree over them, otherwise the kd-tree engine builds its own.
+  KMeansClustering(RNG& rng, std::shared_ptr<const PointSet> colors, const size_t num_clusters,
+                   const ClusteringAlgorithm algorithm = ClusteringAlgorithm::Lloyd,
+                   const SeedingMethod seeding = SeedingMethod::Random,
+                   const size_t num_threads = ThreadPool::default_num_threads(),
+                   std::shared_ptr<const KdTree> kd_tree = nullptr);
 
-  void run(const size_t num_iterations);
+  // Runs at most max_iterations iterations. Stops early once no centroid moved by more than
+  // tolerance or once at most min_moved_fraction of the colors changed their cluster (the latter
+  // is not available with engines that don't track assignments). Returns the number of iterations
+  // that were run.
+  size_t run(const size_t max_iterations, const float tolerance = 0.0f,
+             const float min_moved_fraction = 0.0f);
+
+  // Mini-batch k-means: every iteration moves the centroids towards batch_size colors drawn at
+  // random, with a per-centroid learning rate of 1 / (weight of colors seen so far). Stops after
+  // max_iterations or once no centroid moved by more than tolerance during a batch. A final full
+  // Lloyd iteration can be requested to settle the centroids. Returns the number of batches used.
+  size_t run_minibatch(const size_t batch_size, const size_t max_iterations,
+                       const float tolerance = 0.0f, const bool final_full_pass = false);
+
+  // Final assignment pass with the current centers, returns the weighted sum of squared distances
+  // of colors to their closest center
+  double compute_inertia();
+
+  // Weighted sum of squared distances of colors to the centers found by the last iteration of
+  // run(), with the assignments of that iteration. Gathered during the iteration, so it costs no
+  // extra pass; it is never below compute_inertia(). Empty unless the last run() (or the final
+  // pass of run_minibatch()) ran an iteration.
+  std::optional<double> last_inertia() const { return last_inertia_; }
+
+  // Adds a cluster centered at the farthest color of the cluster with the largest inertia, so a
+  // solution with one more cluster can be refined from this one. Returns false if every color
+  // already coincides with a center.
+  bool split_worst_cluster();
+
+  // Mean silhouette coefficient of num_samples colors drawn at random (O(num_samples^2)). Reuses
+  // the assignments of a preceding compute_inertia() for the same centers.
+  double compute_silhouette(const size_t num_samples);
+
+  // Replaces the cluster centers, e.g. to refine a palette found by another method. Colors are
+  // converted to the working color space.
+  void set_clusters(const std::vector<Color>& clusters);
 
   size_t num_clusters() const { return clusters_.size(); }
   const std::vector<Color>& get_clusters() const { return clusters_; }
 
  private:
-  void assign_colors_to_clusters();
-  void recalculate_cluster_positions();
+  // Assigns every color to its closest cluster and gathers per-cluster sums in the same sweep.
+  // Returns the number of colors that changed their cluster.
+  size_t assign_colors_to_clusters();
+  // Returns the largest distance a cluster center moved by
+  float recalculate_cluster_positions();
 
   std::vector<Color> clusters_;
-  std::vector<size_t> cluster_assignments_;
-  std::vector<Color> colors_;
+  CentroidSet centroids_;
+  std::vector<uint32_t> cluster_assignments_;
+  // Filled by compute_inertia()
+  std::vector<double> cluster_inertias_;
+  std::vector<size_t> farthest_colors_;
+  std::optional<double> last_inertia_;
+  std::shared_ptr<const PointSet> colors_;
+  ThreadAccumulators thread_accumulators_;
   RNG rng_;
-};
\ No newline at end of file
+  ThreadPool thread_pool_;
+  std::unique_ptr<ClusteringEngine> engine_;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ClusteringEngine.hpp"
+
+// Kd-tree with per-node bounds and weighted sums over a point set. It is read-only once built, so
+// engines over the same points, e.g. concurrent restarts, can share a single one.
+class KdTree {
+ public:
+  struct Node {
+    float min[3];
+    float max[3];
+    double sum[3];
+    double weight;
+    // Weighted sum of squared norms, like ClusterAccumulator::squares
+    double squares;
+    uint32_t begin;
+    uint32_t end;
+    // Children are stored as indices into nodes(), -1 for leaves
+    int32_t left;
+    int32_t right;
+  };
+
+  explicit KdTree(const PointSet& points);
+
+  // Points reordered so that every node covers a contiguous range
+  const PointSet& sorted_points() const { return sorted_points_; }
+  const std::vector<Node>& nodes() const { return nodes_; }
+
+ private:
+  int32_t build(const PointSet& points, const uint32_t begin, const uint32_t end,
+                std::vector<uint32_t>& order);
+
+  PointSet sorted_points_;
+  std::vector<Node> nodes_;
+};
+
+// Filtering algorithm of Kanungo et al. A kd-tree with per-node weighted sums is built once over
+// the points. Each iteration walks the tree with a shrinking list of candidate centroids and
+// credits a whole node to a centroid as soon as every other candidate is proven to be farther
+// from all of its points, so the cost depends on the number of visited nodes rather than on the
+// number of points. Per-point assignments are not maintained.
+class KdTreeEngine : public ClusteringEngine {
+ public:
+  // Builds its own tree unless one over the same points is passed in
+  KdTreeEngine(const PointSet& points, ThreadPool& thread_pool,
+               std::shared_ptr<const KdTree> tree = nullptr);
+
+  size_t assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                ThreadAccumulators& thread_accumulators) override;
+
+ private:
+  void filter(const int32_t node_idx, const size_t depth, const CentroidSet& centroids,
+              std::vector<std::vector<uint32_t>>& candidates,
+              std::vector<ClusterAccumulator>& accumulators) const;
+
+  std::shared_ptr<const KdTree> tree_;
+  // Subtrees processed in parallel, one task each
+  std::vector<int32_t> tasks_;
+};
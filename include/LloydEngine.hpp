@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ClusteringEngine.hpp"
+
+// Brute force assignment, every point is tested against every centroid in each iteration
+class LloydEngine : public ClusteringEngine {
+ public:
+  LloydEngine(const PointSet& points, ThreadPool& thread_pool);
+
+  size_t assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                ThreadAccumulators& thread_accumulators) override;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vector>
+
+#include "Color.hpp"
+#include "ColorHistogram.hpp"
+
+// Median cut (Heckbert): starts with a single box around all histogram colors and repeatedly
+// splits the box with the largest population-weighted range along its longest axis at the
+// weighted median. Deterministic, no iterations. Palette colors are the weighted mean colors of
+// the final boxes, in sRGB.
+std::vector<Color> median_cut_palette(const ColorHistogram& histogram, const size_t num_colors);
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.hpp"
+#include "Color.hpp"
+#include "PointSet.hpp"
+
+// Cluster centers in structure-of-arrays layout, as consumed by the assignment kernels
+class CentroidSet {
+ public:
+  void assign(const std::vector<Color>& clusters) {
+    c0_.resize(clusters.size());
+    c1_.resize(clusters.size());
+    c2_.resize(clusters.size());
+    f01_.resize(clusters.size());
+    f2_.resize(clusters.size());
+
+    for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
+      c0_[cluster_idx] = clusters[cluster_idx].r;
+      c1_[cluster_idx] = clusters[cluster_idx].g;
+      c2_[cluster_idx] = clusters[cluster_idx].b;
+
+      f01_[cluster_idx] = to_fixed_point(clusters[cluster_idx].r) |
+                          (to_fixed_point(clusters[cluster_idx].g) << 16);
+      f2_[cluster_idx] = to_fixed_point(clusters[cluster_idx].b);
+    }
+  }
+
+  size_t size() const { return c0_.size(); }
+
+  // Euclidean (not squared) distance between two centroids
+  float distance(const size_t first_idx, const size_t second_idx) const {
+    const float d0 = c0_[first_idx] - c0_[second_idx];
+    const float d1 = c1_[first_idx] - c1_[second_idx];
+    const float d2 = c2_[first_idx] - c2_[second_idx];
+
+    return std::sqrt(d0 * d0 + d1 * d1 + d2 * d2);
+  }
+
+  // Euclidean distance between a centroid of this set and the one with the same index in other
+  float distance(const size_t cluster_idx, const CentroidSet& other) const {
+    const float d0 = c0_[cluster_idx] - other.c0_[cluster_idx];
+    const float d1 = c1_[cluster_idx] - other.c1_[cluster_idx];
+    const float d2 = c2_[cluster_idx] - other.c2_[cluster_idx];
+
+    return std::sqrt(d0 * d0 + d1 * d1 + d2 * d2);
+  }
+
+  const float* c0() const { return c0_.data(); }
+  const float* c1() const { return c1_.data(); }
+  const float* c2() const { return c2_.data(); }
+  // Centers rounded to fixed point, packed like PointSet::f01 and PointSet::f2
+  const uint32_t* f01() const { return f01_.data(); }
+  const uint32_t* f2() const { return f2_.data(); }
+
+ private:
+  AlignedVector<float> c0_;
+  AlignedVector<float> c1_;
+  AlignedVector<float> c2_;
+  AlignedVector<uint32_t> f01_;
+  AlignedVector<uint32_t> f2_;
+};
+
+// Squared distance between a point and a centroid, evaluated exactly like the assignment kernels.
+// Float32 storage only, like find_two_nearest_centroids.
+inline float squared_distance(const PointSet& points, const size_t point_idx,
+                              const CentroidSet& centroids, const size_t cluster_idx) {
+  const float d0 = points.c0()[point_idx] - centroids.c0()[cluster_idx];
+  const float d1 = points.c1()[point_idx] - centroids.c1()[cluster_idx];
+  const float d2 = points.c2()[point_idx] - centroids.c2()[cluster_idx];
+
+  return d0 * d0 + d1 * d1 + d2 * d2;
+}
+
+// Finds the closest centroid for every point in [begin, end). Results for point i are written to
+// assignments[i - begin] and, unless distances is null, distances[i - begin] (squared distance).
+// Uses AVX or SSE when available; every path gives the same results as Color::distance. Float16
+// points are widened to floats first.
+void find_nearest_centroids(const PointSet& points, const size_t begin, const size_t end,
+                            const CentroidSet& centroids, uint32_t* assignments, float* distances);
+
+// Same for count points given as separate component arrays, results for point i go to index i
+void find_nearest_centroids(const float* p0, const float* p1, const float* p2, const size_t count,
+                            const CentroidSet& centroids, uint32_t* assignments, float* distances);
+
+// Portable reference implementations of find_nearest_centroids
+void find_nearest_centroids_scalar(const PointSet& points, const size_t begin, const size_t end,
+                                   const CentroidSet& centroids, uint32_t* assignments,
+                                   float* distances);
+void find_nearest_centroids_scalar(const float* p0, const float* p1, const float* p2,
+                                   const size_t count, const CentroidSet& centroids,
+                                   uint32_t* assignments, float* distances);
+
+// Integer kernel for fixed point points: squared distances to the fixed point centers are computed
+// exactly with 16-bit multiply-adds, so every build and machine picks the same centers. Distances
+// are written as floats, scaled back to the working color space.
+void find_nearest_centroids_fixed(const uint32_t* p01, const uint32_t* p2, const size_t count,
+                                  const CentroidSet& centroids, uint32_t* assignments,
+                                  float* distances);
+
+// Converts fixed point components packed like PointSet::f01 and PointSet::f2 to floats
+void widen_fixed_point(const uint32_t* p01, const uint32_t* p2, const size_t count, float* c0,
+                       float* c1, float* c2);
+
+// Converts count packed halves to floats, with F16C when available
+void widen_halves(const uint16_t* halves, const size_t count, float* values);
+
+// Finds the closest and the second closest centroid of a single point (squared distances). Ties
+// are resolved like in find_nearest_centroids. second_distance is infinite with a single centroid.
+void find_two_nearest_centroids(const PointSet& points, const size_t point_idx,
+                                const CentroidSet& centroids, uint32_t& closest,
+                                float& closest_distance, float& second_distance);
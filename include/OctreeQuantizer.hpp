@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Color.hpp"
+#include "Image.hpp"
+
+// Octree color quantizer (Gervautz and Purgathofer), filled while an image is being loaded. Each
+// level of the tree splits the sRGB cube on the next bit of every channel, so full-depth leaves
+// hold single 8-bit colors. Whenever the tree grows past max_nodes the deepest internal node is
+// collapsed into a leaf, which keeps memory bounded regardless of the image size. Only the
+// quantizer is bounded, the Image that feeds it still keeps every pixel for the preview.
+class OctreeQuantizer : public PixelSink {
+ public:
+  static constexpr unsigned int kMaxDepth = 8;
+  // A single color needs a full path from the root to a leaf
+  static constexpr size_t kMinNodes = kMaxDepth + 1;
+  static constexpr size_t kDefaultMaxNodes = size_t{1} << 16;
+
+  OctreeQuantizer(const size_t max_nodes, const bool skip_black);
+
+  void consume(const unsigned char* rgb, const size_t num_pixels) override;
+
+  // Collapses the tree until it has at most num_colors leaves, starting with the least populated
+  // nodes of the deepest level, and returns the mean colors of the leaves in sRGB
+  std::vector<Color> palette(const size_t num_colors);
+
+  size_t num_leaves() const { return num_leaves_; }
+
+ private:
+  struct Node {
+    uint64_t r = 0;
+    uint64_t g = 0;
+    uint64_t b = 0;
+    // Pixels in the subtree, internal nodes only use it to pick what to collapse first
+    uint64_t count = 0;
+    std::array<int32_t, 8> children;
+    bool is_leaf = false;
+  };
+
+  void insert(const unsigned char r, const unsigned char g, const unsigned char b);
+  int32_t create_node(const unsigned int level);
+  int32_t deepest_reducible_level() const;
+  void reduce(const int32_t node_idx);
+
+  size_t max_nodes_;
+  bool skip_black_;
+
+  std::vector<Node> nodes_;
+  std::vector<int32_t> free_nodes_;
+  // Internal nodes of every level, the children of the deepest ones are all leaves
+  std::array<std::vector<int32_t>, kMaxDepth> reducible_;
+  size_t num_leaves_;
+};
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "AlignedAllocator.hpp"
+#include "Color.hpp"
+#include "Half.hpp"
+
+class ColorHistogram;
+class Image;
+class RNG;
+
+// Half precision storage halves the memory and the traffic of every assignment sweep, at the cost
+// of about three significant decimal digits per component. Fixed16 stores components in [0, 1] as
+// 14-bit fractions for the integer kernel, which suits srgb and linear_srgb.
+enum class PointStorage { Float32, Float16, Fixed16 };
+
+// Fixed point one. Differences of fixed point values in [0, 1] fit 16 bits and three squares of
+// them sum up within 31 bits, so integer distances are exact. The scale is a power of two, so
+// fixed point values convert to floats and sum up in doubles without rounding.
+constexpr int32_t kFixedPointOne = 1 << 14;
+
+inline uint32_t to_fixed_point(const float value) {
+  return static_cast<uint32_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * kFixedPointOne));
+}
+
+inline float from_fixed_point(const uint32_t value) {
+  return static_cast<float>(value) * (1.0f / kFixedPointOne);
+}
+
+// Colors stored as three separate, aligned component arrays (structure of arrays). A weighted set
+// additionally stores a weight per color, e.g. the number of pixels it stands for; colors of an
+// unweighted set all have a weight of one. Components are packed as halves with Float16 storage
+// and as fixed point pairs with Fixed16 storage, the float arrays stay empty then.
+class PointSet {
+ public:
+  PointSet(ColorSpace color_space, const bool weighted = false,
+           const PointStorage storage = PointStorage::Float32)
+      : color_space_(color_space), weighted_(weighted), storage_(storage), total_weight_(0.0) {}
+
+  // Every pixel of the image converted to color_space
+  static PointSet fromImage(const Image& image, const ColorSpace color_space,
+                            const bool skip_black,
+                            const PointStorage storage = PointStorage::Float32,
+                            const ConversionAccuracy accuracy = ConversionAccuracy::Accurate);
+  // About num_samples pixels of the image converted to color_space: the image is divided into a
+  // grid of roughly square cells and one pixel is picked at random from every cell
+  static PointSet fromImageStratified(const Image& image, const ColorSpace color_space,
+                                      const bool skip_black, const size_t num_samples, RNG& rng,
+                                      const PointStorage storage = PointStorage::Float32,
+                                      const ConversionAccuracy accuracy =
+                                          ConversionAccuracy::Accurate);
+  // Every distinct color of the histogram converted to color_space, weighted by its pixel count
+  static PointSet fromHistogram(const ColorHistogram& histogram, const ColorSpace color_space,
+                                const PointStorage storage = PointStorage::Float32,
+                                const ConversionAccuracy accuracy = ConversionAccuracy::Accurate);
+
+  void reserve(const size_t size) {
+    if (storage_ == PointStorage::Float16) {
+      h0_.reserve(size);
+      h1_.reserve(size);
+      h2_.reserve(size);
+    } else if (storage_ == PointStorage::Fixed16) {
+      f01_.reserve(size);
+      f2_.reserve(size);
+    } else {
+      c0_.reserve(size);
+      c1_.reserve(size);
+      c2_.reserve(size);
+    }
+
+    if (weighted_) {
+      weights_.reserve(size);
+    }
+  }
+
+  void clear() {
+    c0_.clear();
+    c1_.clear();
+    c2_.clear();
+    h0_.clear();
+    h1_.clear();
+    h2_.clear();
+    f01_.clear();
+    f2_.clear();
+    weights_.clear();
+    total_weight_ = 0.0;
+  }
+
+  void add(const Color& color, const double weight = 1.0) {
+    if (storage_ == PointStorage::Float16) {
+      h0_.push_back(float_to_half(color.r));
+      h1_.push_back(float_to_half(color.g));
+      h2_.push_back(float_to_half(color.b));
+    } else if (storage_ == PointStorage::Fixed16) {
+      f01_.push_back(to_fixed_point(color.r) | (to_fixed_point(color.g) << 16));
+      f2_.push_back(to_fixed_point(color.b));
+    } else {
+      c0_.push_back(color.r);
+      c1_.push_back(color.g);
+      c2_.push_back(color.b);
+    }
+
+    if (weighted_) {
+      weights_.push_back(weight);
+    }
+
+    total_weight_ += weight;
+  }
+
+  Color operator[](const size_t index) const {
+    if (storage_ == PointStorage::Float16) {
+      return Color{half_to_float_fast(h0_[index]), half_to_float_fast(h1_[index]),
+                   half_to_float_fast(h2_[index]), color_space_};
+    }
+
+    if (storage_ == PointStorage::Fixed16) {
+      return Color{from_fixed_point(f01_[index] & 0xFFFFu), from_fixed_point(f01_[index] >> 16),
+                   from_fixed_point(f2_[index]), color_space_};
+    }
+
+    return Color{c0_[index], c1_[index], c2_[index], color_space_};
+  }
+
+  size_t size() const {
+    switch (storage_) {
+      case PointStorage::Float16:
+        return h0_.size();
+      case PointStorage::Fixed16:
+        return f2_.size();
+      default:
+        return c0_.size();
+    }
+  }
+  bool empty() const { return size() == 0; }
+  ColorSpace getColorSpace() const { return color_space_; }
+  PointStorage getStorage() const { return storage_; }
+
+  bool isWeighted() const { return weighted_; }
+  double weight(const size_t index) const { return weighted_ ? weights_[index] : 1.0; }
+  double getTotalWeight() const { return total_weight_; }
+
+  const float* c0() const { return c0_.data(); }
+  const float* c1() const { return c1_.data(); }
+  const float* c2() const { return c2_.data(); }
+  // Packed components of Float16 sets
+  const uint16_t* h0() const { return h0_.data(); }
+  const uint16_t* h1() const { return h1_.data(); }
+  const uint16_t* h2() const { return h2_.data(); }
+  // Fixed point components of Fixed16 sets: the first two packed in the low and the high half of
+  // one word, the third one alone with a zero high half, ready for 16-bit multiply-adds
+  const uint32_t* f01() const { return f01_.data(); }
+  const uint32_t* f2() const { return f2_.data(); }
+  // Null for unweighted sets
+  const double* weights() const { return weighted_ ? weights_.data() : nullptr; }
+
+ private:
+  ColorSpace color_space_;
+  bool weighted_;
+  PointStorage storage_;
+  double total_weight_;
+  AlignedVector<float> c0_;
+  AlignedVector<float> c1_;
+  AlignedVector<float> c2_;
+  AlignedVector<uint16_t> h0_;
+  AlignedVector<uint16_t> h1_;
+  AlignedVector<uint16_t> h2_;
+  AlignedVector<uint32_t> f01_;
+  AlignedVector<uint32_t> f2_;
+  std::vector<double> weights_;
+};
@@ -14,6 +14,10 @@ class RNG {
     const auto uniform_real = getReal();
     return static_cast<size_t>(std::floor(min + uniform_real * (max - min)));
   }
+  // Uniform index in [0, size), unlike getInteger it reaches every index of very large ranges
+  size_t getIndex(size_t size) {
+    return std::uniform_int_distribution<size_t>{0, size - 1}(random_engine_);
+  }
 
  private:
   std::mt19937 random_engine_;
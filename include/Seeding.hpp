@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "Color.hpp"
+#include "PointSet.hpp"
+#include "RNG.hpp"
+#include "ThreadPool.hpp"
+
+enum class SeedingMethod { Random, KMeansPlusPlus, KMeansParallel, Wu };
+
+// Picks num_clusters distinct colors at random, with probability proportional to their weights
+std::vector<Color> seed_random(const PointSet& points, const size_t num_clusters, RNG& rng);
+
+// k-means++: every next center is drawn with probability proportional to its weighted squared
+// distance to the closest center chosen so far
+std::vector<Color> seed_kmeanspp(const PointSet& points, const size_t num_clusters, RNG& rng,
+                                 ThreadPool& thread_pool);
+
+// k-means|| (Bahmani et al.): a few oversampling rounds draw about 2 * num_clusters candidates
+// each, in parallel over the thread pool. Candidates are then weighted by the colors closest to
+// them and reduced to num_clusters centers with weighted k-means++.
+std::vector<Color> seed_kmeans_parallel(const PointSet& points, const size_t num_clusters, RNG& rng,
+                                        ThreadPool& thread_pool);
+
+// Wu's quantizer over the sRGB values of the colors, every center is the mean of the colors in one
+// of its boxes. Deterministic, the generator is not used.
+std::vector<Color> seed_wu(const PointSet& points, const size_t num_clusters,
+                           ThreadPool& thread_pool);
+
+std::vector<Color> seed_clusters(const SeedingMethod method, const PointSet& points,
+                                 const size_t num_clusters, RNG& rng, ThreadPool& thread_pool);
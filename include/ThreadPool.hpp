@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+  using Task = std::function<void(size_t thread_idx, size_t begin, size_t end)>;
+
+  ThreadPool(const size_t num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  // Splits [0, count) into num_threads() contiguous chunks and runs task on each of them. The
+  // first chunk is processed on the calling thread. Blocks until all chunks are done.
+  void parallel_for(const size_t count, const Task& task);
+
+  static size_t default_num_threads();
+
+ private:
+  void worker_loop(const size_t thread_idx);
+  void run_chunk(const size_t thread_idx) const;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable work_done_;
+
+  const Task* task_;
+  size_t count_;
+  size_t generation_;
+  size_t pending_workers_;
+  bool stop_;
+};
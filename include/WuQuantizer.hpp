@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Color.hpp"
+#include "ColorHistogram.hpp"
+
+// Wu's color quantizer (Graphics Gems II): colors are binned into a 32^3 grid over sRGB and
+// cumulative moment tables of the bins let the variance of any box be evaluated in O(1). The box
+// with the largest variance is repeatedly split in two at the position that minimizes the summed
+// variance of the halves.
+class WuQuantizer {
+ public:
+  static constexpr uint32_t kGridSize = 33;
+  static constexpr uint32_t kNumCells = kGridSize * kGridSize * kGridSize;
+
+  WuQuantizer();
+
+  // Grid cell of a color in sRGB, the first row of every axis stays empty for the cumulative sums
+  static uint32_t cell_index(const Color& color);
+
+  void add(const Color& color, const double weight) { add(cell_index(color), color, weight); }
+  void add(const uint32_t cell_idx, const Color& color, const double weight);
+  // Adds the colors of another quantizer, e.g. one filled by a different thread
+  void merge(const WuQuantizer& other);
+
+  // Splits the cube into at most num_boxes boxes, fewer when some of them would stay empty.
+  // Returns the number of boxes, no colors can be added afterwards.
+  size_t split(const size_t num_boxes);
+
+  // Box of a grid cell after split()
+  uint32_t box_index(const uint32_t cell_idx) const { return cell_boxes_[cell_idx]; }
+
+  // Weighted mean colors of the boxes in sRGB
+  std::vector<Color> box_means() const;
+
+ private:
+  struct Box {
+    // Lower bounds are exclusive, upper bounds inclusive
+    std::array<uint32_t, 3> min;
+    std::array<uint32_t, 3> max;
+    uint32_t volume;
+  };
+
+  enum Moment { kWeight, kR, kG, kB, kNumMoments };
+
+  static uint32_t index(const uint32_t r, const uint32_t g, const uint32_t b) {
+    return (r * kGridSize + g) * kGridSize + b;
+  }
+
+  void compute_cumulative_moments();
+  // Signed sum of the cumulative moment over the four box corners that lie in the plane where
+  // the given axis equals position
+  double plane_sum(const Box& box, const size_t axis, const uint32_t position,
+                   const std::vector<double>& moment) const;
+  double volume(const Box& box, const std::vector<double>& moment) const;
+  double variance(const Box& box) const;
+  double maximize(const Box& box, const size_t axis, const std::array<double, kNumMoments>& whole,
+                  uint32_t& cut) const;
+  bool cut(Box& box1, Box& box2) const;
+
+  std::array<std::vector<double>, kNumMoments> moments_;
+  // Weighted sum of squared channel values
+  std::vector<double> squares_;
+
+  std::vector<Box> boxes_;
+  std::vector<uint32_t> cell_boxes_;
+};
+
+// Palette of at most num_colors Wu boxes over the colors of the histogram, in sRGB
+std::vector<Color> wu_palette(const ColorHistogram& histogram, const size_t num_colors);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ClusteringEngine.hpp"
+
+// Yinyang k-means (Ding et al.): centroids are grouped once into about num_clusters / 10 groups
+// and every point keeps an upper bound plus one lower bound per group. Whole groups are skipped
+// when their bound proves that none of their centroids can be closer, which prunes far more than
+// Hamerly's single bound with much less memory than Elkan's per-centroid bounds.
+class YinyangEngine : public ClusteringEngine {
+ public:
+  YinyangEngine(const PointSet& points, ThreadPool& thread_pool);
+
+  size_t assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                ThreadAccumulators& thread_accumulators) override;
+
+ private:
+  void group_centroids(const CentroidSet& centroids);
+  size_t initialize_bounds(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                           ThreadAccumulators& thread_accumulators);
+
+  size_t num_groups_;
+  std::vector<uint32_t> centroid_groups_;
+  std::vector<std::vector<uint32_t>> group_members_;
+
+  std::vector<float> upper_bounds_;
+  // num_groups_ bounds per point, bound of a group excludes the centroid the point is assigned to
+  std::vector<float> lower_bounds_;
+  CentroidSet previous_centroids_;
+  bool initialized_;
+};
@@ -0,0 +1,33 @@
+#include "ClusteringEngine.hpp"
+
+#include <stdexcept>
+
+#include "ElkanEngine.hpp"
+#include "HamerlyEngine.hpp"
+#include "KdTreeEngine.hpp"
+#include "LloydEngine.hpp"
+#include "YinyangEngine.hpp"
+
+std::unique_ptr<ClusteringEngine> make_clustering_engine(
+    const ClusteringAlgorithm algorithm, const PointSet& points, ThreadPool& thread_pool,
+    std::shared_ptr<const KdTree> kd_tree) {
+  // The bounds based engines read float components directly
+  if (points.getStorage() != PointStorage::Float32 && algorithm != ClusteringAlgorithm::Lloyd) {
+    throw std::invalid_argument("Packed point storage is only supported by the Lloyd engine!");
+  }
+
+  switch (algorithm) {
+    case ClusteringAlgorithm::Lloyd:
+      return std::make_unique<LloydEngine>(points, thread_pool);
+    case ClusteringAlgorithm::Hamerly:
+      return std::make_unique<HamerlyEngine>(points, thread_pool);
+    case ClusteringAlgorithm::Elkan:
+      return std::make_unique<ElkanEngine>(points, thread_pool);
+    case ClusteringAlgorithm::Yinyang:
+      return std::make_unique<YinyangEngine>(points, thread_pool);
+    case ClusteringAlgorithm::KdTree:
+      return std::make_unique<KdTreeEngine>(points, thread_pool, std::move(kd_tree));
+    default:
+      throw std::runtime_error("Unsupported clustering algorithm!");
+  }
+}
@@ -0,0 +1,407 @@
+#include "ColorConversion.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+
+// Just enough of a float vector for the conversion stages and the transfer functions below.
+// Comparisons return all-ones lanes as masks for select().
+#if defined(__AVX2__)
+
+struct FloatVec {
+  static constexpr size_t kLanes = 8;
+
+  FloatVec(const __m256 value) : v(value) {}
+  FloatVec(const float value) : v(_mm256_set1_ps(value)) {}
+
+  static FloatVec load(const float* values) { return _mm256_loadu_ps(values); }
+  void store(float* values) const { _mm256_storeu_ps(values, v); }
+
+  FloatVec& operator*=(const FloatVec& other) {
+    v = _mm256_mul_ps(v, other.v);
+    return *this;
+  }
+
+  __m256 v;
+};
+
+struct IntVec {
+  IntVec(const __m256i value) : v(value) {}
+  IntVec(const int32_t value) : v(_mm256_set1_epi32(value)) {}
+
+  __m256i v;
+};
+
+inline FloatVec operator+(const FloatVec& a, const FloatVec& b) { return _mm256_add_ps(a.v, b.v); }
+inline FloatVec operator-(const FloatVec& a, const FloatVec& b) { return _mm256_sub_ps(a.v, b.v); }
+inline FloatVec operator*(const FloatVec& a, const FloatVec& b) { return _mm256_mul_ps(a.v, b.v); }
+inline FloatVec operator/(const FloatVec& a, const FloatVec& b) { return _mm256_div_ps(a.v, b.v); }
+inline FloatVec operator&(const FloatVec& a, const FloatVec& b) { return _mm256_and_ps(a.v, b.v); }
+inline FloatVec operator|(const FloatVec& a, const FloatVec& b) { return _mm256_or_ps(a.v, b.v); }
+inline FloatVec and_not(const FloatVec& a, const FloatVec& b) { return _mm256_andnot_ps(b.v, a.v); }
+inline FloatVec less(const FloatVec& a, const FloatVec& b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ);
+}
+inline FloatVec less_equal(const FloatVec& a, const FloatVec& b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ);
+}
+inline FloatVec equal(const FloatVec& a, const FloatVec& b) {
+  return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ);
+}
+inline FloatVec select(const FloatVec& mask, const FloatVec& a, const FloatVec& b) {
+  return _mm256_blendv_ps(b.v, a.v, mask.v);
+}
+
+inline IntVec operator+(const IntVec& a, const IntVec& b) { return _mm256_add_epi32(a.v, b.v); }
+inline IntVec operator-(const IntVec& a, const IntVec& b) { return _mm256_sub_epi32(a.v, b.v); }
+inline IntVec operator&(const IntVec& a, const IntVec& b) { return _mm256_and_si256(a.v, b.v); }
+inline IntVec operator|(const IntVec& a, const IntVec& b) { return _mm256_or_si256(a.v, b.v); }
+inline IntVec operator<<(const IntVec& a, const int bits) { return _mm256_slli_epi32(a.v, bits); }
+inline IntVec operator>>(const IntVec& a, const int bits) { return _mm256_srli_epi32(a.v, bits); }
+
+inline IntVec bits_of(const FloatVec& a) { return _mm256_castps_si256(a.v); }
+inline FloatVec from_bits(const IntVec& a) { return _mm256_castsi256_ps(a.v); }
+inline FloatVec to_float(const IntVec& a) { return _mm256_cvtepi32_ps(a.v); }
+// Rounds to nearest
+inline IntVec to_int(const FloatVec& a) { return _mm256_cvtps_epi32(a.v); }
+
+#else
+
+struct FloatVec {
+  static constexpr size_t kLanes = 4;
+
+  FloatVec(const __m128 value) : v(value) {}
+  FloatVec(const float value) : v(_mm_set1_ps(value)) {}
+
+  static FloatVec load(const float* values) { return _mm_loadu_ps(values); }
+  void store(float* values) const { _mm_storeu_ps(values, v); }
+
+  FloatVec& operator*=(const FloatVec& other) {
+    v = _mm_mul_ps(v, other.v);
+    return *this;
+  }
+
+  __m128 v;
+};
+
+struct IntVec {
+  IntVec(const __m128i value) : v(value) {}
+  IntVec(const int32_t value) : v(_mm_set1_epi32(value)) {}
+
+  __m128i v;
+};
+
+inline FloatVec operator+(const FloatVec& a, const FloatVec& b) { return _mm_add_ps(a.v, b.v); }
+inline FloatVec operator-(const FloatVec& a, const FloatVec& b) { return _mm_sub_ps(a.v, b.v); }
+inline FloatVec operator*(const FloatVec& a, const FloatVec& b) { return _mm_mul_ps(a.v, b.v); }
+inline FloatVec operator/(const FloatVec& a, const FloatVec& b) { return _mm_div_ps(a.v, b.v); }
+inline FloatVec operator&(const FloatVec& a, const FloatVec& b) { return _mm_and_ps(a.v, b.v); }
+inline FloatVec operator|(const FloatVec& a, const FloatVec& b) { return _mm_or_ps(a.v, b.v); }
+inline FloatVec and_not(const FloatVec& a, const FloatVec& b) { return _mm_andnot_ps(b.v, a.v); }
+inline FloatVec less(const FloatVec& a, const FloatVec& b) { return _mm_cmplt_ps(a.v, b.v); }
+inline FloatVec less_equal(const FloatVec& a, const FloatVec& b) { return _mm_cmple_ps(a.v, b.v); }
+inline FloatVec equal(const FloatVec& a, const FloatVec& b) { return _mm_cmpeq_ps(a.v, b.v); }
+// SSE2 has no blend instruction
+inline FloatVec select(const FloatVec& mask, const FloatVec& a, const FloatVec& b) {
+  return (mask & a) | and_not(b, mask);
+}
+
+inline IntVec operator+(const IntVec& a, const IntVec& b) { return _mm_add_epi32(a.v, b.v); }
+inline IntVec operator-(const IntVec& a, const IntVec& b) { return _mm_sub_epi32(a.v, b.v); }
+inline IntVec operator&(const IntVec& a, const IntVec& b) { return _mm_and_si128(a.v, b.v); }
+inline IntVec operator|(const IntVec& a, const IntVec& b) { return _mm_or_si128(a.v, b.v); }
+inline IntVec operator<<(const IntVec& a, const int bits) { return _mm_slli_epi32(a.v, bits); }
+inline IntVec operator>>(const IntVec& a, const int bits) { return _mm_srli_epi32(a.v, bits); }
+
+inline IntVec bits_of(const FloatVec& a) { return _mm_castps_si128(a.v); }
+inline FloatVec from_bits(const IntVec& a) { return _mm_castsi128_ps(a.v); }
+inline FloatVec to_float(const IntVec& a) { return _mm_cvtepi32_ps(a.v); }
+// Rounds to nearest
+inline IntVec to_int(const FloatVec& a) { return _mm_cvtps_epi32(a.v); }
+
+#endif
+
+// Natural logarithm of positive normal values, after Cephes' logf
+FloatVec log(const FloatVec& x) {
+  const auto bits = bits_of(x);
+
+  // x = m * 2^e with m in [0.5, 1)
+  auto e = to_float((bits >> 23) - IntVec{126});
+  auto m = from_bits((bits & IntVec{0x007FFFFF}) | IntVec{0x3F000000});
+
+  // Shift m to [sqrt(0.5), sqrt(2)) around one, where the polynomial is accurate
+  const auto small = less(m, 0.70710678f);
+  e = e - (FloatVec{1.0f} & small);
+  m = m - 1.0f + (m & small);
+
+  const auto z = m * m;
+  auto y = FloatVec{7.0376836292e-2f};
+  y = y * m - 1.1514610310e-1f;
+  y = y * m + 1.1676998740e-1f;
+  y = y * m - 1.2420140846e-1f;
+  y = y * m + 1.4249322787e-1f;
+  y = y * m - 1.6668057665e-1f;
+  y = y * m + 2.0000714765e-1f;
+  y = y * m - 2.4999993993e-1f;
+  y = y * m + 3.3333331174e-1f;
+  y = y * m * z;
+
+  // ln(2) split in two parts, the first one multiplies with e exactly
+  y = y + e * -2.12194440e-4f;
+  y = y - 0.5f * z;
+  return m + y + e * 0.693359375f;
+}
+
+// Exponential function for arguments in about [-87, 88], after Cephes' expf
+FloatVec exp(const FloatVec& x) {
+  const auto n = to_int(x * 1.44269504088896341f);
+  const auto n_float = to_float(n);
+
+  auto r = x - n_float * 0.693359375f;
+  r = r - n_float * -2.12194440e-4f;
+
+  const auto z = r * r;
+  auto y = FloatVec{1.9875691500e-4f};
+  y = y * r + 1.3981999507e-3f;
+  y = y * r + 8.3334519073e-3f;
+  y = y * r + 4.1665795894e-2f;
+  y = y * r + 1.6666665459e-1f;
+  y = y * r + 5.0000001201e-1f;
+  y = y * z + r + 1.0f;
+
+  return y * from_bits((n + IntVec{127}) << 23);
+}
+
+FloatVec srgb_decode(const FloatVec& c) {
+  const auto linear = c / 12.92f;
+  const auto curve = exp(2.4f * log((c + 0.055f) / 1.055f));
+  return select(less_equal(c, 0.04045f), linear, curve);
+}
+
+FloatVec srgb_encode(const FloatVec& c) {
+  const float y = 1.0f / 2.4f;
+
+  const auto linear = c * 12.92f;
+  const auto curve = 1.055f * exp(y * log(c)) - 0.055f;
+  return select(less_equal(c, 0.0031308f), linear, curve);
+}
+
+// Cube root from a bit level estimate refined by Newton steps. The estimate is within 3.2%, every
+// step squares the relative error. Two steps make the same floats as the scalar cube_root_fast().
+template <int steps>
+FloatVec cube_root_newton(const FloatVec& c) {
+  const auto sign = c & from_bits(IntVec{static_cast<int32_t>(0x80000000u)});
+  const auto a = and_not(c, sign);
+
+  // Dividing the exponent by three divides the bits by three, up to a constant
+  auto y = from_bits(to_int(to_float(bits_of(a)) * (1.0f / 3.0f) + 709921077.0f));
+  for (int step = 0; step < steps; ++step) {
+    y = (1.0f / 3.0f) * (y + y + a / (y * y));
+  }
+
+  return select(equal(a, 0.0f), c, y | sign);
+}
+
+FloatVec cube_root(const FloatVec& c) { return cube_root_newton<3>(c); }
+
+FloatVec cube_root_fast(const FloatVec& c) { return cube_root_newton<2>(c); }
+
+constexpr size_t kLanes = FloatVec::kLanes;
+
+#endif
+
+template <ColorSpace from, ColorSpace to, ConversionAccuracy accuracy>
+void convert_planar(float* c0, float* c1, float* c2, const size_t count) {
+  size_t idx = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  for (; idx + kLanes <= count; idx += kLanes) {
+    auto x = FloatVec::load(c0 + idx);
+    auto y = FloatVec::load(c1 + idx);
+    auto z = FloatVec::load(c2 + idx);
+
+    convert<from, to, accuracy>(x, y, z);
+
+    x.store(c0 + idx);
+    y.store(c1 + idx);
+    z.store(c2 + idx);
+  }
+
+  // The remaining colors go through a padded vector, so every color converts to the same values
+  // wherever it sits in the input
+  if (idx < count) {
+    const auto remaining = count - idx;
+
+    float x_lanes[kLanes] = {};
+    float y_lanes[kLanes] = {};
+    float z_lanes[kLanes] = {};
+    std::memcpy(x_lanes, c0 + idx, remaining * sizeof(float));
+    std::memcpy(y_lanes, c1 + idx, remaining * sizeof(float));
+    std::memcpy(z_lanes, c2 + idx, remaining * sizeof(float));
+
+    auto x = FloatVec::load(x_lanes);
+    auto y = FloatVec::load(y_lanes);
+    auto z = FloatVec::load(z_lanes);
+
+    convert<from, to, accuracy>(x, y, z);
+
+    x.store(x_lanes);
+    y.store(y_lanes);
+    z.store(z_lanes);
+    std::memcpy(c0 + idx, x_lanes, remaining * sizeof(float));
+    std::memcpy(c1 + idx, y_lanes, remaining * sizeof(float));
+    std::memcpy(c2 + idx, z_lanes, remaining * sizeof(float));
+  }
+#else
+  for (; idx < count; ++idx) {
+    convert<from, to, accuracy>(c0[idx], c1[idx], c2[idx]);
+  }
+#endif
+}
+
+}  // namespace
+
+void convert_colors(const ColorSpace from, const ColorSpace to, float* c0, float* c1, float* c2,
+                    const size_t count, const ConversionAccuracy accuracy) {
+  if (from == to) {
+    return;
+  }
+
+  dispatch_color_space(from, [&](auto source) {
+    dispatch_color_space(to, [&](auto target) {
+      constexpr auto source_space = decltype(source)::value;
+      constexpr auto target_space = decltype(target)::value;
+
+      if (accuracy == ConversionAccuracy::Fast) {
+        convert_planar<source_space, target_space, ConversionAccuracy::Fast>(c0, c1, c2, count);
+      } else {
+        convert_planar<source_space, target_space, ConversionAccuracy::Accurate>(c0, c1, c2,
+                                                                                 count);
+      }
+    });
+  });
+}
+
+void convert_colors(const ColorSpace from, const ColorSpace to, const float* interleaved,
+                    const size_t count, float* c0, float* c1, float* c2,
+                    const ConversionAccuracy accuracy) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    c0[idx] = interleaved[3 * idx];
+    c1[idx] = interleaved[3 * idx + 1];
+    c2[idx] = interleaved[3 * idx + 2];
+  }
+
+  convert_colors(from, to, c0, c1, c2, count, accuracy);
+}
+
+#if defined(__AVX2__)
+
+namespace {
+
+// Low bytes of the eight lanes, which hold values in [0, 255]
+void store_bytes(const __m256i values, uint8_t* bytes) {
+  const auto words = _mm256_packus_epi32(values, values);
+  const auto packed = _mm256_packus_epi16(words, words);
+
+  const auto low = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+  const auto high = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+  std::memcpy(bytes, &low, 4);
+  std::memcpy(bytes + 4, &high, 4);
+}
+
+}  // namespace
+
+void encode_srgb8(const float* values, const size_t count, uint8_t* bytes) {
+  const auto* table = reinterpret_cast<const int*>(kSrgbEncodeTable.data());
+  const auto* thresholds = kSrgbEncodeThresholds.data();
+
+  size_t idx = 0;
+  for (; idx + 8 <= count; idx += 8) {
+    // Same clamping as the scalar version, max() returns its second operand for NaNs
+    const auto clamped = _mm256_min_ps(
+        _mm256_max_ps(_mm256_loadu_ps(values + idx), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    const auto bin =
+        _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(clamped, _mm256_set1_ps(4096.0f))),
+                         _mm256_set1_epi32(static_cast<int>(kSrgbEncodeBins - 1)));
+
+    auto encoded = _mm256_and_si256(_mm256_i32gather_epi32(table, bin, 1), _mm256_set1_epi32(0xFF));
+    const auto threshold = _mm256_i32gather_ps(thresholds, encoded, 4);
+
+    // All-ones lanes are -1
+    encoded = _mm256_sub_epi32(
+        encoded, _mm256_castps_si256(_mm256_cmp_ps(clamped, threshold, _CMP_GE_OQ)));
+    store_bytes(encoded, bytes + idx);
+  }
+
+  for (; idx < count; ++idx) {
+    bytes[idx] = encode_srgb8(values[idx]);
+  }
+}
+
+void pack_unorm8(const float* values, const size_t count, uint8_t* bytes) {
+  size_t idx = 0;
+  for (; idx + 8 <= count; idx += 8) {
+    const auto scaled = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(values + idx),
+                                                    _mm256_set1_ps(255.0f)),
+                                      _mm256_set1_ps(0.5f));
+    const auto clamped = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_setzero_ps()),
+                                       _mm256_set1_ps(255.0f));
+    store_bytes(_mm256_cvttps_epi32(clamped), bytes + idx);
+  }
+
+  for (; idx < count; ++idx) {
+    bytes[idx] = pack_unorm8(values[idx]);
+  }
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+// SSE2 has no gathers, the table lookups stay scalar
+void encode_srgb8(const float* values, const size_t count, uint8_t* bytes) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    bytes[idx] = encode_srgb8(values[idx]);
+  }
+}
+
+void pack_unorm8(const float* values, const size_t count, uint8_t* bytes) {
+  size_t idx = 0;
+  for (; idx + 4 <= count; idx += 4) {
+    const auto scaled =
+        _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(values + idx), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+    const auto clamped =
+        _mm_min_ps(_mm_max_ps(scaled, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+
+    const auto words = _mm_packs_epi32(_mm_cvttps_epi32(clamped), _mm_setzero_si128());
+    const auto packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+    std::memcpy(bytes + idx, &packed, 4);
+  }
+
+  for (; idx < count; ++idx) {
+    bytes[idx] = pack_unorm8(values[idx]);
+  }
+}
+
+#else
+
+void encode_srgb8(const float* values, const size_t count, uint8_t* bytes) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    bytes[idx] = encode_srgb8(values[idx]);
+  }
+}
+
+void pack_unorm8(const float* values, const size_t count, uint8_t* bytes) {
+  for (size_t idx = 0; idx < count; ++idx) {
+    bytes[idx] = pack_unorm8(values[idx]);
+  }
+}
+
+#endif
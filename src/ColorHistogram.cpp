@@ -0,0 +1,70 @@
+#include "ColorHistogram.hpp"
+
+#include <stdexcept>
+#include <string>
+
+ColorHistogram::ColorHistogram(const unsigned int bits_per_channel, const bool skip_black)
+    : bits_per_channel_(bits_per_channel), skip_black_(skip_black), total_count_(0) {
+  if (bits_per_channel_ < 1 || bits_per_channel_ > 8) {
+    throw std::invalid_argument("Unsupported number of histogram bits per channel (" +
+                                std::to_string(bits_per_channel) + ")!");
+  }
+
+  // With 8 bits this is a 64 MiB table, still cheaper than hashing for large images
+  const size_t num_bins = size_t{1} << (3 * bits_per_channel_);
+  bin_counts_.assign(num_bins, 0);
+
+  if (bits_per_channel_ < 8) {
+    bin_sums_.assign(3 * num_bins, 0);
+  }
+}
+
+void ColorHistogram::consume(const unsigned char* rgb, const size_t num_pixels) {
+  const auto track_sums = !bin_sums_.empty();
+
+  for (size_t pixel_idx = 0; pixel_idx < num_pixels; ++pixel_idx) {
+    const auto r = rgb[3 * pixel_idx];
+    const auto g = rgb[3 * pixel_idx + 1];
+    const auto b = rgb[3 * pixel_idx + 2];
+
+    if (skip_black_ && r == 0 && g == 0 && b == 0) {
+      continue;
+    }
+
+    const auto bin_idx = bin_index(r, g, b);
+    bin_counts_[bin_idx] += 1;
+
+    if (track_sums) {
+      bin_sums_[3 * bin_idx] += r;
+      bin_sums_[3 * bin_idx + 1] += g;
+      bin_sums_[3 * bin_idx + 2] += b;
+    }
+  }
+}
+
+void ColorHistogram::finish() {
+  const auto track_sums = !bin_sums_.empty();
+
+  for (uint32_t bin_idx = 0; bin_idx < bin_counts_.size(); ++bin_idx) {
+    const auto count = bin_counts_[bin_idx];
+
+    if (count == 0) {
+      continue;
+    }
+
+    if (track_sums) {
+      const auto f = 1.0f / (255.0f * count);
+      colors_.emplace_back(bin_sums_[3 * bin_idx] * f, bin_sums_[3 * bin_idx + 1] * f,
+                           bin_sums_[3 * bin_idx + 2] * f);
+    } else {
+      colors_.emplace_back(((bin_idx >> 16) & 0xFF) / 255.0f, ((bin_idx >> 8) & 0xFF) / 255.0f,
+                           (bin_idx & 0xFF) / 255.0f);
+    }
+
+    counts_.push_back(count);
+    total_count_ += count;
+  }
+
+  bin_counts_ = std::vector<uint32_t>{};
+  bin_sums_ = std::vector<uint64_t>{};
+}
@@ -0,0 +1,135 @@
+#include "Coreset.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+
+#include "NearestCentroid.hpp"
+#include "Seeding.hpp"
+
+PointSet build_coreset(const PointSet& points, const size_t num_clusters,
+                       const size_t coreset_size, RNG& rng, ThreadPool& thread_pool) {
+  if (points.size() <= coreset_size || num_clusters == 0) {
+    return points;
+  }
+
+  CentroidSet centers;
+  centers.assign(seed_kmeanspp(points, num_clusters, rng, thread_pool));
+
+  std::vector<uint32_t> assignments(points.size());
+  std::vector<float> distances(points.size());
+
+  thread_pool.parallel_for(points.size(), [&](size_t, size_t begin, size_t end) {
+    find_nearest_centroids(points, begin, end, centers, assignments.data() + begin,
+                           distances.data() + begin);
+  });
+
+  std::vector<double> cluster_weights(centers.size(), 0.0);
+  std::vector<double> cluster_costs(centers.size(), 0.0);
+  double total_cost = 0.0;
+
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    const auto weight = points.weight(point_idx);
+    const auto cost = weight * distances[point_idx];
+
+    cluster_weights[assignments[point_idx]] += weight;
+    cluster_costs[assignments[point_idx]] += cost;
+    total_cost += cost;
+  }
+
+  // Upper bound of the sensitivity of every color, alpha follows from the O(log k) approximation
+  // guarantee of k-means++. When the initial solution is exact only the cluster sizes matter.
+  const auto alpha = 16.0 * (std::log(static_cast<double>(centers.size())) + 2.0);
+  const auto cost_scale = total_cost > 0.0 ? alpha / total_cost : 0.0;
+
+  std::vector<double> cumulative_sensitivities(points.size());
+  double total_sensitivity = 0.0;
+
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    const auto cluster_idx = assignments[point_idx];
+    const auto cluster_weight = cluster_weights[cluster_idx];
+
+    const auto sensitivity =
+        points.weight(point_idx) *
+        (cost_scale * distances[point_idx] +
+         (2.0 * cost_scale * cluster_costs[cluster_idx] + 4.0) / cluster_weight);
+
+    total_sensitivity += sensitivity;
+    cumulative_sensitivities[point_idx] = total_sensitivity;
+  }
+
+  // Colors drawn more than once are merged, their weights add up
+  std::map<size_t, double> sampled_weights;
+
+  for (size_t sample_idx = 0; sample_idx < coreset_size; ++sample_idx) {
+    const auto target = rng.getReal() * total_sensitivity;
+    const auto found = std::upper_bound(cumulative_sensitivities.begin(),
+                                        cumulative_sensitivities.end(), target);
+    const auto point_idx =
+        std::min(static_cast<size_t>(found - cumulative_sensitivities.begin()), points.size() - 1);
+
+    const auto previous = point_idx > 0 ? cumulative_sensitivities[point_idx - 1] : 0.0;
+    const auto probability = (cumulative_sensitivities[point_idx] - previous) / total_sensitivity;
+
+    sampled_weights[point_idx] += points.weight(point_idx) / (coreset_size * probability);
+  }
+
+  // Packed components widen and pack again without rounding, so the coreset keeps the storage
+  PointSet coreset{points.getColorSpace(), true, points.getStorage()};
+  coreset.reserve(sampled_weights.size());
+
+  for (const auto& [point_idx, weight] : sampled_weights) {
+    coreset.add(points[point_idx], weight);
+  }
+
+  return coreset;
+}
+
+bool save_coreset(const PointSet& coreset, const std::string& filename) {
+  std::ofstream file{filename};
+  if (!file) {
+    return false;
+  }
+
+  file.precision(std::numeric_limits<float>::max_digits10);
+
+  for (size_t color_idx = 0; color_idx < coreset.size(); ++color_idx) {
+    const auto color = coreset[color_idx].convertTo(ColorSpace::sRGB);
+    file << color.r << " " << color.g << " " << color.b << " " << coreset.weight(color_idx)
+         << "\n";
+  }
+
+  return static_cast<bool>(file);
+}
+
+std::optional<PointSet> load_coreset(const std::string& filename, const ColorSpace color_space,
+                                     const PointStorage storage) {
+  std::ifstream file{filename};
+  if (!file) {
+    return std::nullopt;
+  }
+
+  PointSet coreset{color_space, true, storage};
+  std::string line;
+
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    std::istringstream line_stream{line};
+    float r, g, b;
+    double weight;
+
+    if (!(line_stream >> r >> g >> b >> weight) || weight <= 0.0) {
+      return std::nullopt;
+    }
+
+    coreset.add(Color{r, g, b}.convertTo(color_space), weight);
+  }
+
+  return coreset;
+}
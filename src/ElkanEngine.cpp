@@ -0,0 +1,149 @@
+#include "ElkanEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ElkanEngine::ElkanEngine(const PointSet& points, ThreadPool& thread_pool)
+    : ClusteringEngine(points, thread_pool), upper_bounds_(points.size()), initialized_(false) {}
+
+size_t ElkanEngine::assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                           ThreadAccumulators& thread_accumulators) {
+  if (!initialized_ || previous_centroids_.size() != centroids.size()) {
+    return initialize_bounds(centroids, assignments, thread_accumulators);
+  }
+
+  const auto num_clusters = centroids.size();
+
+  std::vector<float> shifts(num_clusters);
+  for (size_t cluster_idx = 0; cluster_idx < num_clusters; ++cluster_idx) {
+    shifts[cluster_idx] = centroids.distance(cluster_idx, previous_centroids_);
+  }
+
+  half_centroid_distances_.resize(num_clusters * num_clusters);
+  half_separations_.assign(num_clusters, std::numeric_limits<float>::infinity());
+
+  for (size_t first_idx = 0; first_idx < num_clusters; ++first_idx) {
+    half_centroid_distances_[first_idx * num_clusters + first_idx] = 0.0f;
+
+    for (size_t second_idx = first_idx + 1; second_idx < num_clusters; ++second_idx) {
+      const auto half_distance = 0.5f * centroids.distance(first_idx, second_idx);
+      half_centroid_distances_[first_idx * num_clusters + second_idx] = half_distance;
+      half_centroid_distances_[second_idx * num_clusters + first_idx] = half_distance;
+      half_separations_[first_idx] = std::min(half_separations_[first_idx], half_distance);
+      half_separations_[second_idx] = std::min(half_separations_[second_idx], half_distance);
+    }
+  }
+
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      auto* lower_bounds = lower_bounds_.data() + point_idx * num_clusters;
+      auto& upper_bound = upper_bounds_[point_idx];
+      const auto initial_cluster_idx = assignments[point_idx];
+      auto cluster_idx = initial_cluster_idx;
+
+      for (size_t other_idx = 0; other_idx < num_clusters; ++other_idx) {
+        lower_bounds[other_idx] = std::max(0.0f, lower_bounds[other_idx] - shifts[other_idx]);
+      }
+
+      upper_bound += shifts[cluster_idx];
+
+      if (!definitely_closer(upper_bound, half_separations_[cluster_idx])) {
+        // Squared distance to the current cluster, evaluated lazily (negative until known)
+        float cluster_distance = -1.0f;
+
+        for (size_t other_idx = 0; other_idx < num_clusters; ++other_idx) {
+          if (other_idx == cluster_idx) {
+            continue;
+          }
+
+          const auto* half_distances = &half_centroid_distances_[cluster_idx * num_clusters];
+          if (definitely_closer(upper_bound, lower_bounds[other_idx]) ||
+              definitely_closer(upper_bound, half_distances[other_idx])) {
+            continue;
+          }
+
+          if (cluster_distance < 0.0f) {
+            cluster_distance = squared_distance(points_, point_idx, centroids, cluster_idx);
+            upper_bound = std::sqrt(cluster_distance);
+            lower_bounds[cluster_idx] = upper_bound;
+
+            if (definitely_closer(upper_bound, lower_bounds[other_idx]) ||
+                definitely_closer(upper_bound, half_distances[other_idx])) {
+              continue;
+            }
+          }
+
+          const auto other_distance = squared_distance(points_, point_idx, centroids, other_idx);
+          lower_bounds[other_idx] = std::sqrt(other_distance);
+
+          // Same tie breaking as the brute force search, the lower index wins
+          if (other_distance < cluster_distance ||
+              (other_distance == cluster_distance && other_idx < cluster_idx)) {
+            cluster_idx = static_cast<uint32_t>(other_idx);
+            cluster_distance = other_distance;
+            upper_bound = lower_bounds[other_idx];
+          }
+        }
+      }
+
+      moved += initial_cluster_idx != cluster_idx;
+      assignments[point_idx] = cluster_idx;
+      accumulate(accumulators, point_idx, cluster_idx);
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  previous_centroids_ = centroids;
+  return total_moved_count();
+}
+
+size_t ElkanEngine::initialize_bounds(const CentroidSet& centroids,
+                                      std::vector<uint32_t>& assignments,
+                                      ThreadAccumulators& thread_accumulators) {
+  const auto num_clusters = centroids.size();
+  lower_bounds_.resize(points_.size() * num_clusters);
+
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      auto* lower_bounds = lower_bounds_.data() + point_idx * num_clusters;
+
+      float closest_distance = std::numeric_limits<float>::max();
+      uint32_t cluster_idx = 0;
+
+      for (size_t other_idx = 0; other_idx < num_clusters; ++other_idx) {
+        const auto distance = squared_distance(points_, point_idx, centroids, other_idx);
+        lower_bounds[other_idx] = std::sqrt(distance);
+
+        if (distance < closest_distance) {
+          closest_distance = distance;
+          cluster_idx = static_cast<uint32_t>(other_idx);
+        }
+      }
+
+      moved += assignments[point_idx] != cluster_idx;
+      assignments[point_idx] = cluster_idx;
+      upper_bounds_[point_idx] = lower_bounds[cluster_idx];
+
+      accumulate(accumulators, point_idx, cluster_idx);
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  previous_centroids_ = centroids;
+  initialized_ = true;
+
+  return total_moved_count();
+}
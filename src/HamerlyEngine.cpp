@@ -0,0 +1,123 @@
+#include "HamerlyEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+HamerlyEngine::HamerlyEngine(const PointSet& points, ThreadPool& thread_pool)
+    : ClusteringEngine(points, thread_pool),
+      upper_bounds_(points.size()),
+      lower_bounds_(points.size()),
+      initialized_(false) {}
+
+size_t HamerlyEngine::assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                             ThreadAccumulators& thread_accumulators) {
+  if (!initialized_ || previous_centroids_.size() != centroids.size()) {
+    return initialize_bounds(centroids, assignments, thread_accumulators);
+  }
+
+  const auto num_clusters = centroids.size();
+
+  // Largest and second largest centroid movement, the lower bound of a point has to be decreased
+  // by the largest movement among centroids other than the assigned one
+  std::vector<float> shifts(num_clusters);
+  size_t max_shift_idx = 0;
+  float max_shift = 0.0f;
+  float second_max_shift = 0.0f;
+
+  for (size_t cluster_idx = 0; cluster_idx < num_clusters; ++cluster_idx) {
+    shifts[cluster_idx] = centroids.distance(cluster_idx, previous_centroids_);
+
+    if (shifts[cluster_idx] > max_shift) {
+      second_max_shift = max_shift;
+      max_shift = shifts[cluster_idx];
+      max_shift_idx = cluster_idx;
+    } else if (shifts[cluster_idx] > second_max_shift) {
+      second_max_shift = shifts[cluster_idx];
+    }
+  }
+
+  // Half of the distance from each centroid to the closest other one
+  half_separations_.assign(num_clusters, std::numeric_limits<float>::infinity());
+  for (size_t first_idx = 0; first_idx < num_clusters; ++first_idx) {
+    for (size_t second_idx = first_idx + 1; second_idx < num_clusters; ++second_idx) {
+      const auto half_distance = 0.5f * centroids.distance(first_idx, second_idx);
+      half_separations_[first_idx] = std::min(half_separations_[first_idx], half_distance);
+      half_separations_[second_idx] = std::min(half_separations_[second_idx], half_distance);
+    }
+  }
+
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      auto cluster_idx = assignments[point_idx];
+      auto& upper_bound = upper_bounds_[point_idx];
+      auto& lower_bound = lower_bounds_[point_idx];
+
+      upper_bound += shifts[cluster_idx];
+      lower_bound -= cluster_idx == max_shift_idx ? second_max_shift : max_shift;
+
+      const auto bound = std::max(half_separations_[cluster_idx], lower_bound);
+
+      if (!definitely_closer(upper_bound, bound)) {
+        upper_bound = std::sqrt(squared_distance(points_, point_idx, centroids, cluster_idx));
+
+        if (!definitely_closer(upper_bound, bound)) {
+          float closest_distance = 0.0f;
+          float second_distance = 0.0f;
+          find_two_nearest_centroids(points_, point_idx, centroids, cluster_idx,
+                                     closest_distance, second_distance);
+
+          moved += assignments[point_idx] != cluster_idx;
+          assignments[point_idx] = cluster_idx;
+          upper_bound = std::sqrt(closest_distance);
+          lower_bound = std::sqrt(second_distance);
+        }
+      }
+
+      accumulate(accumulators, point_idx, cluster_idx);
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  previous_centroids_ = centroids;
+  return total_moved_count();
+}
+
+size_t HamerlyEngine::initialize_bounds(const CentroidSet& centroids,
+                                        std::vector<uint32_t>& assignments,
+                                        ThreadAccumulators& thread_accumulators) {
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      uint32_t cluster_idx = 0;
+      float closest_distance = 0.0f;
+      float second_distance = 0.0f;
+      find_two_nearest_centroids(points_, point_idx, centroids, cluster_idx, closest_distance,
+                                 second_distance);
+
+      moved += assignments[point_idx] != cluster_idx;
+      assignments[point_idx] = cluster_idx;
+      upper_bounds_[point_idx] = std::sqrt(closest_distance);
+      lower_bounds_[point_idx] = std::sqrt(second_distance);
+
+      accumulate(accumulators, point_idx, cluster_idx);
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  previous_centroids_ = centroids;
+  initialized_ = true;
+
+  return total_moved_count();
+}
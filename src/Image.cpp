@@ -3,6 +3,8 @@
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <stdexcept>
+#include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -10,7 +12,12 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-Image::Image(const std::string& filename) {
+Image::Image(const std::string& filename, PixelSink* sink, const ColorSpace color_space)
+    : color_space_(color_space) {
+  if (color_space_ != ColorSpace::sRGB && color_space_ != ColorSpace::sRGBLinear) {
+    throw std::invalid_argument("Images can only be loaded into sRGB or linear sRGB!");
+  }
+
   int width_s = 0;
   int height_s = 0;
 
@@ -25,14 +32,30 @@ Image::Image(const std::string& filename) {
   len_ = 3 * width_ * height_;
   pixels_ = std::make_unique<float[]>(len_);
 
-  for (unsigned int i = 0; i < len_; ++i) {
-    pixels_[i] = reinterpret_cast<unsigned char*>(data)[i] / 255.0f;
+  if (color_space_ == ColorSpace::sRGBLinear) {
+    for (unsigned int i = 0; i < len_; ++i) {
+      pixels_[i] = kSrgbDecodeTable[data[i]];
+    }
+  } else {
+    for (unsigned int i = 0; i < len_; ++i) {
+      pixels_[i] = reinterpret_cast<unsigned char*>(data)[i] / 255.0f;
+    }
+  }
+
+  if (sink) {
+    sink->consume(data, static_cast<size_t>(width_) * height_);
+    sink->finish();
   }
 
   stbi_image_free(data);
 }
 
-Image::Image(unsigned int width, unsigned int height) : width_(width), height_(height) {
+Image::Image(unsigned int width, unsigned int height, const ColorSpace color_space)
+    : width_(width), height_(height), color_space_(color_space) {
+  if (color_space_ != ColorSpace::sRGB && color_space_ != ColorSpace::sRGBLinear) {
+    throw std::invalid_argument("Images can only be stored in sRGB or linear sRGB!");
+  }
+
   len_ = 3 * width * height;
   pixels_ = std::make_unique<float[]>(len_);
   memset(pixels_.get(), 0, len_ * sizeof(float));
@@ -42,6 +65,7 @@ Image::Image(const Image& other) {
   width_ = other.width_;
   height_ = other.height_;
   len_ = other.len_;
+  color_space_ = other.color_space_;
 
   pixels_ = std::make_unique<float[]>(len_);
   memcpy(pixels_.get(), other.pixels_.get(), len_ * sizeof(float));
@@ -51,36 +75,50 @@ Image::Image(Image&& other) {
   width_ = other.width_;
   height_ = other.height_;
   len_ = other.len_;
+  color_space_ = other.color_space_;
   pixels_ = std::move(other.pixels_);
 }
 
 void Image::clear(const Color& color) {
+  const auto converted = color.convertTo(color_space_);
+
   for (unsigned int i = 0; i < len_;) {
-    pixels_[i++] = color.r;
-    pixels_[i++] = color.g;
-    pixels_[i++] = color.b;
+    pixels_[i++] = converted.r;
+    pixels_[i++] = converted.g;
+    pixels_[i++] = converted.b;
   }
 }
 
 void Image::drawRectangle(const Color& color, unsigned int x, unsigned int y, unsigned int width,
                           unsigned int height) {
+  const auto converted = color.convertTo(color_space_);
+
   for (unsigned int ry = 0; ry < height; ++ry) {
     for (unsigned int rx = 0; rx < width; ++rx) {
       const auto targetX = x + rx;
       const auto targetY = y + ry;
 
-      setPixel(targetX, targetY, color);
+      setPixel(targetX, targetY, converted);
     }
   }
 }
 
 void Image::drawImage(const Image& image, unsigned int x, unsigned int y) {
+  // Rows are converted in one batch each, in case the color spaces differ
+  std::vector<float> c0(image.width_);
+  std::vector<float> c1(image.width_);
+  std::vector<float> c2(image.width_);
+
   for (unsigned int ry = 0; ry < image.getHeight(); ++ry) {
+    const auto* row = image.pixels_.get() + 3 * static_cast<size_t>(ry) * image.width_;
+    convert_colors(image.color_space_, color_space_, row, image.width_, c0.data(), c1.data(),
+                   c2.data());
+
     for (unsigned int rx = 0; rx < image.getWidth(); ++rx) {
       const auto targetX = x + rx;
       const auto targetY = y + ry;
 
-      setPixel(targetX, targetY, image.getPixel(rx, ry));
+      setPixel(targetX, targetY, Color{c0[rx], c1[rx], c2[rx], color_space_});
     }
   }
 }
@@ -90,9 +128,12 @@ bool Image::save(const std::string& filename) const {
 
   int result = 0;
   if (output_extension == ".png") {
+    // Files are always sRGB, linear images are encoded while packing
     auto pixels_u8 = std::make_unique<unsigned char[]>(len_);
-    for (unsigned int i = 0; i < len_; ++i) {
-      pixels_u8[i] = std::min(255.0f, std::max(0.0f, 255.0f * pixels_[i] + 0.5f));
+    if (color_space_ == ColorSpace::sRGBLinear) {
+      encode_srgb8(pixels_.get(), len_, pixels_u8.get());
+    } else {
+      pack_unorm8(pixels_.get(), len_, pixels_u8.get());
     }
 
     const auto stride = 3 * width_;
@@ -109,6 +150,7 @@ Image& Image::operator=(const Image& other) {
     width_ = other.width_;
     height_ = other.height_;
     len_ = other.len_;
+    color_space_ = other.color_space_;
 
     pixels_ = std::make_unique<float[]>(len_);
     memcpy(pixels_.get(), other.pixels_.get(), len_ * sizeof(float));
@@ -122,6 +164,7 @@ Image& Image::operator=(Image&& other) {
     width_ = other.width_;
     height_ = other.height_;
     len_ = other.len_;
+    color_space_ = other.color_space_;
     pixels_ = std::move(other.pixels_);
   }
 
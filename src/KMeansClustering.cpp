@@ -1,78 +1,328 @@
 #include "KMeansClustering.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <numeric>
 
-KMeansClustering::KMeansClustering(RNG& rng, const Image& image, const size_t num_clusters,
-                                   const ColorSpace color_space, const bool skip_black)
-    : colors_(), rng_(rng) {
-  for (unsigned int y = 0; y < image.getHeight(); ++y) {
-    for (unsigned int x = 0; x < image.getWidth(); ++x) {
-      const auto& color = image.getPixel(x, y);
+KMeansClustering::KMeansClustering(RNG& rng, std::shared_ptr<const PointSet> colors,
+                                   const size_t num_clusters, const ClusteringAlgorithm algorithm,
+                                   const SeedingMethod seeding, const size_t num_threads,
+                                   std::shared_ptr<const KdTree> kd_tree)
+    : colors_(std::move(colors)), rng_(rng), thread_pool_(num_threads) {
+  cluster_assignments_ = std::vector<uint32_t>(colors_->size(), 0);
+  thread_accumulators_.resize(thread_pool_.num_threads());
+  engine_ = make_clustering_engine(algorithm, *colors_, thread_pool_, std::move(kd_tree));
 
-      if (skip_black) {
-        if (color.r == 0.0f && color.g == 0.0f && color.b == 0.0f) {
-          continue;
-        }
-      }
+  clusters_ = seed_clusters(seeding, *colors_, num_clusters, rng_, thread_pool_);
+}
+
+size_t KMeansClustering::run(const size_t max_iterations, const float tolerance,
+                             const float min_moved_fraction) {
+  cluster_inertias_.clear();
+  farthest_colors_.clear();
+  last_inertia_.reset();
+
+  for (size_t iteration = 0; iteration < max_iterations; ++iteration) {
+    const auto moved = assign_colors_to_clusters();
+    const auto max_shift = recalculate_cluster_positions();
 
-      colors_.emplace_back(color.convertTo(color_space));
+    // The first assignment is compared against the placeholder one, so it can't tell convergence
+    const auto moved_fraction = static_cast<float>(moved) / std::max<size_t>(colors_->size(), 1);
+    const auto few_moved = iteration > 0 && moved != ClusteringEngine::kUnknownMovedCount &&
+                           moved_fraction <= min_moved_fraction;
+
+    if (max_shift <= tolerance || few_moved) {
+      return iteration + 1;
     }
   }
 
-  clusters_.reserve(num_clusters);
-  cluster_assignments_ = std::vector<size_t>(colors_.size(), 0);
-
-  std::sample(colors_.begin(), colors_.end(), std::back_inserter(clusters_), num_clusters,
-              rng_.getEngine());
+  return max_iterations;
 }
 
-void KMeansClustering::run(const size_t num_iterations) {
-  for (size_t iteration = 0; iteration < num_iterations; ++iteration) {
+size_t KMeansClustering::run_minibatch(const size_t batch_size, const size_t max_iterations,
+                                       const float tolerance, const bool final_full_pass) {
+  cluster_inertias_.clear();
+  farthest_colors_.clear();
+  last_inertia_.reset();
+
+  PointSet batch{colors_->getColorSpace()};
+  batch.reserve(batch_size);
+  std::vector<double> batch_weights(batch_size);
+  std::vector<uint32_t> batch_assignments(batch_size);
+  std::vector<double> seen_weights(clusters_.size(), 0.0);
+
+  size_t iteration = 0;
+  while (iteration < max_iterations && !colors_->empty()) {
+    batch.clear();
+    for (size_t batch_idx = 0; batch_idx < batch_size; ++batch_idx) {
+      const auto color_idx = rng_.getIndex(colors_->size());
+      batch.add((*colors_)[color_idx]);
+      batch_weights[batch_idx] = colors_->weight(color_idx);
+    }
+
+    centroids_.assign(clusters_);
+    thread_pool_.parallel_for(batch_size, [&](size_t, size_t begin, size_t end) {
+      find_nearest_centroids(batch, begin, end, centroids_, batch_assignments.data() + begin,
+                             nullptr);
+    });
+
+    const auto previous_clusters = clusters_;
+
+    for (size_t batch_idx = 0; batch_idx < batch_size; ++batch_idx) {
+      const auto cluster_idx = batch_assignments[batch_idx];
+      seen_weights[cluster_idx] += batch_weights[batch_idx];
+
+      const auto learning_rate =
+          static_cast<float>(batch_weights[batch_idx] / seen_weights[cluster_idx]);
+      const auto color = batch[batch_idx];
+      auto& cluster = clusters_[cluster_idx];
+
+      cluster.r += learning_rate * (color.r - cluster.r);
+      cluster.g += learning_rate * (color.g - cluster.g);
+      cluster.b += learning_rate * (color.b - cluster.b);
+    }
+
+    iteration += 1;
+
+    float max_shift = 0.0f;
+    for (size_t cluster_idx = 0; cluster_idx < clusters_.size(); ++cluster_idx) {
+      const auto shift = clusters_[cluster_idx].distance(previous_clusters[cluster_idx]);
+      max_shift = std::max(max_shift, std::sqrt(shift));
+    }
+
+    if (max_shift <= tolerance) {
+      break;
+    }
+  }
+
+  if (final_full_pass) {
     assign_colors_to_clusters();
     recalculate_cluster_positions();
   }
+
+  return iteration;
 }
 
-void KMeansClustering::assign_colors_to_clusters() {
-  for (size_t color_idx = 0; color_idx < colors_.size(); ++color_idx) {
-    const auto& color = colors_[color_idx];
+void KMeansClustering::set_clusters(const std::vector<Color>& clusters) {
+  clusters_.clear();
 
-    float min_distance = std::numeric_limits<float>::max();
-    size_t closest_cluster_id = 0;
+  for (const auto& cluster : clusters) {
+    clusters_.emplace_back(cluster.convertTo(colors_->getColorSpace()));
+  }
 
-    for (size_t cluster_idx = 0; cluster_idx < clusters_.size(); ++cluster_idx) {
-      const auto distance = color.distance(clusters_[cluster_idx]);
+  cluster_inertias_.clear();
+  farthest_colors_.clear();
+  last_inertia_.reset();
+}
+
+double KMeansClustering::compute_inertia() {
+  struct ClusterStatistics {
+    double inertia = 0.0;
+    float farthest_distance = -1.0f;
+    size_t farthest_color_idx = 0;
+  };
+
+  const auto num_clusters = clusters_.size();
+  std::vector<std::vector<ClusterStatistics>> thread_statistics(
+      thread_pool_.num_threads(), std::vector<ClusterStatistics>(num_clusters));
+
+  centroids_.assign(clusters_);
+
+  thread_pool_.parallel_for(colors_->size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    constexpr size_t kBlockSize = 512;
+    float distances[kBlockSize];
+    auto& statistics = thread_statistics[thread_idx];
+
+    for (size_t block_begin = begin; block_begin < end; block_begin += kBlockSize) {
+      const auto block_end = std::min(end, block_begin + kBlockSize);
+      find_nearest_centroids(*colors_, block_begin, block_end, centroids_,
+                             cluster_assignments_.data() + block_begin, distances);
+
+      for (size_t color_idx = block_begin; color_idx < block_end; ++color_idx) {
+        const auto distance = distances[color_idx - block_begin];
+        auto& cluster_statistics = statistics[cluster_assignments_[color_idx]];
+        cluster_statistics.inertia += colors_->weight(color_idx) * distance;
 
-      if (distance < min_distance) {
-        min_distance = distance;
-        closest_cluster_id = cluster_idx;
+        if (distance > cluster_statistics.farthest_distance) {
+          cluster_statistics.farthest_distance = distance;
+          cluster_statistics.farthest_color_idx = color_idx;
+        }
       }
     }
+  });
+
+  cluster_inertias_.assign(num_clusters, 0.0);
+  farthest_colors_.assign(num_clusters, 0);
+  std::vector<float> farthest_distances(num_clusters, -1.0f);
+  double inertia = 0.0;
+
+  for (const auto& statistics : thread_statistics) {
+    for (size_t cluster_idx = 0; cluster_idx < num_clusters; ++cluster_idx) {
+      cluster_inertias_[cluster_idx] += statistics[cluster_idx].inertia;
+      inertia += statistics[cluster_idx].inertia;
 
-    cluster_assignments_[color_idx] = closest_cluster_id;
+      if (statistics[cluster_idx].farthest_distance > farthest_distances[cluster_idx]) {
+        farthest_distances[cluster_idx] = statistics[cluster_idx].farthest_distance;
+        farthest_colors_[cluster_idx] = statistics[cluster_idx].farthest_color_idx;
+      }
+    }
   }
+
+  return inertia;
 }
 
-void KMeansClustering::recalculate_cluster_positions() {
-  for (size_t cluster_idx = 0; cluster_idx < clusters_.size(); ++cluster_idx) {
-    Color new_cluster{clusters_[cluster_idx].getColorSpace()};
-    size_t colors_in_cluster = 0;
+bool KMeansClustering::split_worst_cluster() {
+  if (cluster_inertias_.size() != clusters_.size()) {
+    compute_inertia();
+  }
+
+  const auto worst_cluster = std::max_element(cluster_inertias_.begin(), cluster_inertias_.end());
+  if (worst_cluster == cluster_inertias_.end() || *worst_cluster <= 0.0) {
+    return false;
+  }
 
-    for (size_t color_idx = 0; color_idx < colors_.size(); ++color_idx) {
-      if (cluster_assignments_[color_idx] == cluster_idx) {
-        new_cluster += colors_[color_idx];
-        colors_in_cluster += 1;
+  // The farthest color of the worst cluster becomes the new center, the next iterations move the
+  // two halves apart
+  const auto worst_cluster_idx = static_cast<size_t>(worst_cluster - cluster_inertias_.begin());
+  clusters_.emplace_back((*colors_)[farthest_colors_[worst_cluster_idx]]);
+
+  cluster_inertias_.clear();
+  farthest_colors_.clear();
+  last_inertia_.reset();
+
+  return true;
+}
+
+double KMeansClustering::compute_silhouette(const size_t num_samples) {
+  if (clusters_.size() < 2 || colors_->empty()) {
+    return 0.0;
+  }
+
+  // Assignments are up to date if compute_inertia() ran since the centers last changed, like it
+  // does for every candidate of -n auto
+  if (cluster_inertias_.size() != clusters_.size()) {
+    compute_inertia();
+  }
+
+  // Colors are sampled with probability proportional to their weights, so the plain silhouette
+  // of the sample estimates the weighted one of the whole set
+  std::vector<size_t> samples(num_samples);
+  if (colors_->isWeighted()) {
+    std::vector<double> cumulative_weights(colors_->size());
+    std::partial_sum(colors_->weights(), colors_->weights() + colors_->size(),
+                     cumulative_weights.begin());
+
+    for (auto& sample : samples) {
+      const auto target = rng_.getReal() * cumulative_weights.back();
+      const auto found =
+          std::upper_bound(cumulative_weights.begin(), cumulative_weights.end(), target);
+      sample = std::min(static_cast<size_t>(found - cumulative_weights.begin()),
+                        colors_->size() - 1);
+    }
+  } else {
+    for (auto& sample : samples) {
+      sample = rng_.getIndex(colors_->size());
+    }
+  }
+
+  std::vector<double> thread_sums(thread_pool_.num_threads(), 0.0);
+
+  thread_pool_.parallel_for(num_samples, [&](size_t thread_idx, size_t begin, size_t end) {
+    std::vector<double> distance_sums(clusters_.size());
+    std::vector<size_t> counts(clusters_.size());
+    double sum = 0.0;
+
+    for (size_t sample_idx = begin; sample_idx < end; ++sample_idx) {
+      const auto color = (*colors_)[samples[sample_idx]];
+      const auto own_cluster = cluster_assignments_[samples[sample_idx]];
+
+      std::fill(distance_sums.begin(), distance_sums.end(), 0.0);
+      std::fill(counts.begin(), counts.end(), 0);
+
+      for (size_t other_idx = 0; other_idx < num_samples; ++other_idx) {
+        if (other_idx == sample_idx) {
+          continue;
+        }
+
+        const auto other_cluster = cluster_assignments_[samples[other_idx]];
+        distance_sums[other_cluster] +=
+            std::sqrt(color.distance((*colors_)[samples[other_idx]]));
+        counts[other_cluster] += 1;
+      }
+
+      if (counts[own_cluster] == 0) {
+        // Silhouette of a singleton is defined as zero
+        continue;
+      }
+
+      const auto cohesion = distance_sums[own_cluster] / counts[own_cluster];
+      auto separation = std::numeric_limits<double>::max();
+
+      for (size_t cluster_idx = 0; cluster_idx < clusters_.size(); ++cluster_idx) {
+        if (cluster_idx != own_cluster && counts[cluster_idx] > 0) {
+          separation = std::min(separation, distance_sums[cluster_idx] / counts[cluster_idx]);
+        }
+      }
+
+      if (separation < std::numeric_limits<double>::max()) {
+        sum += (separation - cohesion) / std::max(separation, cohesion);
       }
     }
 
-    if (colors_in_cluster > 0) {
-      clusters_[cluster_idx] = new_cluster / colors_in_cluster;
+    thread_sums[thread_idx] = sum;
+  });
+
+  return std::accumulate(thread_sums.begin(), thread_sums.end(), 0.0) / num_samples;
+}
+
+size_t KMeansClustering::assign_colors_to_clusters() {
+  // Threads that get no colors to process won't touch their accumulators, so reset all of them
+  for (auto& accumulators : thread_accumulators_) {
+    accumulators.assign(clusters_.size(), ClusterAccumulator{});
+  }
+
+  centroids_.assign(clusters_);
+  return engine_->assign(centroids_, cluster_assignments_, thread_accumulators_);
+}
+
+float KMeansClustering::recalculate_cluster_positions() {
+  float max_shift = 0.0f;
+  double inertia = 0.0;
+
+  for (size_t cluster_idx = 0; cluster_idx < clusters_.size(); ++cluster_idx) {
+    ClusterAccumulator total{};
+
+    for (const auto& accumulators : thread_accumulators_) {
+      const auto& accumulator = accumulators[cluster_idx];
+      total.r += accumulator.r;
+      total.g += accumulator.g;
+      total.b += accumulator.b;
+      total.weight += accumulator.weight;
+      total.squares += accumulator.squares;
+    }
+
+    Color new_cluster{clusters_[cluster_idx].getColorSpace()};
+
+    if (total.weight > 0.0) {
+      const auto f = 1.0 / total.weight;
+      new_cluster = Color{static_cast<float>(total.r * f), static_cast<float>(total.g * f),
+                          static_cast<float>(total.b * f), new_cluster.getColorSpace()};
+
+      // Sum of squared distances to the mean, clamped against cancellation in tight clusters
+      const auto mean_squares = (total.r * total.r + total.g * total.g + total.b * total.b) * f;
+      inertia += std::max(0.0, total.squares - mean_squares);
     } else {
       std::cout << "WARNING: Empty cluster " << cluster_idx << " will be reinitialized\n";
-      const size_t color_idx = rng_.getInteger(0, colors_.size());
-      clusters_[cluster_idx] = colors_[color_idx];
+      const auto color_idx = rng_.getIndex(colors_->size());
+      new_cluster = (*colors_)[color_idx];
     }
+
+    max_shift = std::max(max_shift, std::sqrt(new_cluster.distance(clusters_[cluster_idx])));
+    clusters_[cluster_idx] = new_cluster;
   }
-}
\ No newline at end of file
+
+  last_inertia_ = inertia;
+  return max_shift;
+}
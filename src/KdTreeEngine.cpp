@@ -0,0 +1,280 @@
+#include "KdTreeEngine.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+constexpr uint32_t kLeafSize = 16;
+// Number of parallel tasks created per thread, more tasks balance uneven subtrees better
+constexpr size_t kTasksPerThread = 8;
+
+float component(const PointSet& points, const size_t point_idx, const size_t dimension) {
+  if (dimension == 0) {
+    return points.c0()[point_idx];
+  } else if (dimension == 1) {
+    return points.c1()[point_idx];
+  } else {
+    return points.c2()[point_idx];
+  }
+}
+
+float centroid_component(const CentroidSet& centroids, const size_t cluster_idx,
+                         const size_t dimension) {
+  if (dimension == 0) {
+    return centroids.c0()[cluster_idx];
+  } else if (dimension == 1) {
+    return centroids.c1()[cluster_idx];
+  } else {
+    return centroids.c2()[cluster_idx];
+  }
+}
+
+}  // namespace
+
+KdTreeEngine::KdTreeEngine(const PointSet& points, ThreadPool& thread_pool,
+                           std::shared_ptr<const KdTree> tree)
+    : ClusteringEngine(points, thread_pool),
+      tree_(tree ? std::move(tree) : std::make_shared<const KdTree>(points)) {
+  const auto& nodes = tree_->nodes();
+
+  // Breadth-first split of the tree into enough independent subtrees for the thread pool
+  const auto num_tasks = kTasksPerThread * thread_pool.num_threads();
+  if (!nodes.empty()) {
+    tasks_.push_back(0);
+  }
+
+  for (size_t task_idx = 0; task_idx < tasks_.size() && tasks_.size() < num_tasks;) {
+    const auto& node = nodes[tasks_[task_idx]];
+
+    if (node.left < 0) {
+      task_idx += 1;
+      continue;
+    }
+
+    const auto right = node.right;
+    tasks_[task_idx] = node.left;
+    tasks_.push_back(right);
+  }
+}
+
+KdTree::KdTree(const PointSet& points) : sorted_points_(points.getColorSpace(), true) {
+  std::vector<uint32_t> order(points.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  if (!points.empty()) {
+    nodes_.reserve(2 * (points.size() / kLeafSize + 1));
+    build(points, 0, static_cast<uint32_t>(points.size()), order);
+  }
+
+  sorted_points_.reserve(points.size());
+  for (const auto point_idx : order) {
+    sorted_points_.add(points[point_idx], points.weight(point_idx));
+  }
+}
+
+int32_t KdTree::build(const PointSet& points, const uint32_t begin, const uint32_t end,
+                      std::vector<uint32_t>& order) {
+  const auto node_idx = static_cast<int32_t>(nodes_.size());
+  nodes_.emplace_back();
+
+  Node node{};
+  node.begin = begin;
+  node.end = end;
+  node.left = -1;
+  node.right = -1;
+
+  for (size_t dimension = 0; dimension < 3; ++dimension) {
+    node.min[dimension] = std::numeric_limits<float>::max();
+    node.max[dimension] = std::numeric_limits<float>::lowest();
+  }
+
+  for (uint32_t idx = begin; idx < end; ++idx) {
+    const auto point_idx = order[idx];
+    const auto weight = points.weight(point_idx);
+    double squared_norm = 0.0;
+
+    for (size_t dimension = 0; dimension < 3; ++dimension) {
+      const auto value = component(points, point_idx, dimension);
+      node.min[dimension] = std::min(node.min[dimension], value);
+      node.max[dimension] = std::max(node.max[dimension], value);
+      node.sum[dimension] += weight * value;
+      squared_norm += static_cast<double>(value) * value;
+    }
+
+    node.weight += weight;
+    node.squares += weight * squared_norm;
+  }
+
+  size_t split_dimension = 0;
+  for (size_t dimension = 1; dimension < 3; ++dimension) {
+    if (node.max[dimension] - node.min[dimension] >
+        node.max[split_dimension] - node.min[split_dimension]) {
+      split_dimension = dimension;
+    }
+  }
+
+  const auto is_degenerate = node.max[split_dimension] <= node.min[split_dimension];
+
+  if (end - begin > kLeafSize && !is_degenerate) {
+    const auto middle = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                     [&](const uint32_t first, const uint32_t second) {
+                       return component(points, first, split_dimension) <
+                              component(points, second, split_dimension);
+                     });
+
+    node.left = build(points, begin, middle, order);
+    node.right = build(points, middle, end, order);
+  }
+
+  nodes_[node_idx] = node;
+  return node_idx;
+}
+
+size_t KdTreeEngine::assign(const CentroidSet& centroids, std::vector<uint32_t>&,
+                            ThreadAccumulators& thread_accumulators) {
+  if (centroids.size() == 0) {
+    return kUnknownMovedCount;
+  }
+
+  thread_pool_.parallel_for(tasks_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    // One candidate list per tree level, reused across the nodes of that level
+    std::vector<std::vector<uint32_t>> candidates(1);
+    auto& accumulators = thread_accumulators[thread_idx];
+
+    for (size_t task_idx = begin; task_idx < end; ++task_idx) {
+      candidates[0].resize(centroids.size());
+      std::iota(candidates[0].begin(), candidates[0].end(), 0);
+
+      filter(tasks_[task_idx], 0, centroids, candidates, accumulators);
+    }
+  });
+
+  return kUnknownMovedCount;
+}
+
+void KdTreeEngine::filter(const int32_t node_idx, const size_t depth,
+                          const CentroidSet& centroids,
+                          std::vector<std::vector<uint32_t>>& candidates,
+                          std::vector<ClusterAccumulator>& accumulators) const {
+  const auto& node = tree_->nodes()[node_idx];
+
+  if (node.left < 0) {
+    // Leaf, candidates are kept in increasing index order so ties resolve like brute force. A
+    // leaf of identical points (e.g. a flat image area) only needs the search for one of them.
+    const auto is_single_color = node.min[0] == node.max[0] && node.min[1] == node.max[1] &&
+                                 node.min[2] == node.max[2];
+    const auto search_end = is_single_color ? node.begin + 1 : node.end;
+    const auto& sorted_points = tree_->sorted_points();
+
+    for (uint32_t point_idx = node.begin; point_idx < search_end; ++point_idx) {
+      uint32_t closest = 0;
+      float min_distance = std::numeric_limits<float>::max();
+
+      for (const auto cluster_idx : candidates[depth]) {
+        const auto distance = squared_distance(sorted_points, point_idx, centroids, cluster_idx);
+
+        if (distance < min_distance) {
+          min_distance = distance;
+          closest = cluster_idx;
+        }
+      }
+
+      auto& accumulator = accumulators[closest];
+
+      if (is_single_color) {
+        accumulator.r += node.sum[0];
+        accumulator.g += node.sum[1];
+        accumulator.b += node.sum[2];
+        accumulator.weight += node.weight;
+        accumulator.squares += node.squares;
+      } else {
+        const auto weight = sorted_points.weight(point_idx);
+        const auto c0 = sorted_points.c0()[point_idx];
+        const auto c1 = sorted_points.c1()[point_idx];
+        const auto c2 = sorted_points.c2()[point_idx];
+        accumulator.r += weight * c0;
+        accumulator.g += weight * c1;
+        accumulator.b += weight * c2;
+        accumulator.weight += weight;
+        accumulator.squares += weight * squared_norm(c0, c1, c2);
+      }
+    }
+
+    return;
+  }
+
+  // Candidate closest to the center of the cell
+  float center[3];
+  for (size_t dimension = 0; dimension < 3; ++dimension) {
+    center[dimension] = 0.5f * (node.min[dimension] + node.max[dimension]);
+  }
+
+  uint32_t best = candidates[depth][0];
+  float best_distance = std::numeric_limits<float>::max();
+
+  for (const auto cluster_idx : candidates[depth]) {
+    float distance = 0.0f;
+    for (size_t dimension = 0; dimension < 3; ++dimension) {
+      const auto d = centroid_component(centroids, cluster_idx, dimension) - center[dimension];
+      distance += d * d;
+    }
+
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = cluster_idx;
+    }
+  }
+
+  if (candidates.size() <= depth + 1) {
+    candidates.emplace_back();
+  }
+
+  auto& remaining = candidates[depth + 1];
+  remaining.clear();
+
+  for (const auto cluster_idx : candidates[depth]) {
+    if (cluster_idx == best) {
+      remaining.push_back(cluster_idx);
+      continue;
+    }
+
+    // Vertex of the cell that lies farthest in the direction from best to the candidate. If even
+    // that vertex is closer to best, best beats the candidate for every point of the cell.
+    float candidate_distance = 0.0f;
+    float best_vertex_distance = 0.0f;
+
+    for (size_t dimension = 0; dimension < 3; ++dimension) {
+      const auto candidate_value = centroid_component(centroids, cluster_idx, dimension);
+      const auto best_value = centroid_component(centroids, best, dimension);
+      const auto vertex =
+          candidate_value > best_value ? node.max[dimension] : node.min[dimension];
+
+      const auto dc = candidate_value - vertex;
+      const auto db = best_value - vertex;
+      candidate_distance += dc * dc;
+      best_vertex_distance += db * db;
+    }
+
+    // Squared distances, pruning only with a margin above the rounding error
+    if (!definitely_closer(best_vertex_distance, candidate_distance)) {
+      remaining.push_back(cluster_idx);
+    }
+  }
+
+  if (remaining.size() == 1) {
+    auto& accumulator = accumulators[remaining[0]];
+    accumulator.r += node.sum[0];
+    accumulator.g += node.sum[1];
+    accumulator.b += node.sum[2];
+    accumulator.weight += node.weight;
+    accumulator.squares += node.squares;
+    return;
+  }
+
+  // The left subtree only writes deeper levels, so the list is still intact for the right one
+  filter(node.left, depth + 1, centroids, candidates, accumulators);
+  filter(node.right, depth + 1, centroids, candidates, accumulators);
+}
@@ -0,0 +1,67 @@
+#include "LloydEngine.hpp"
+
+#include <algorithm>
+
+LloydEngine::LloydEngine(const PointSet& points, ThreadPool& thread_pool)
+    : ClusteringEngine(points, thread_pool) {}
+
+size_t LloydEngine::assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                           ThreadAccumulators& thread_accumulators) {
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    // Points are processed in small blocks, so they are still in cache when accumulated. Halves
+    // are widened once per block and the floats serve both the kernel and the accumulation. Fixed
+    // point values are exact binary fractions, so their sums in the double accumulators are exact.
+    constexpr size_t kBlockSize = 512;
+    uint32_t block_assignments[kBlockSize];
+    alignas(32) float widened[3][kBlockSize];
+
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    for (size_t block_begin = begin; block_begin < end; block_begin += kBlockSize) {
+      const auto count = std::min(kBlockSize, end - block_begin);
+
+      const float* p0 = points_.c0() + block_begin;
+      const float* p1 = points_.c1() + block_begin;
+      const float* p2 = points_.c2() + block_begin;
+
+      if (points_.getStorage() == PointStorage::Fixed16) {
+        // Assignments come from the integer kernel, the floats only feed the accumulators
+        find_nearest_centroids_fixed(points_.f01() + block_begin, points_.f2() + block_begin,
+                                     count, centroids, block_assignments, nullptr);
+        widen_fixed_point(points_.f01() + block_begin, points_.f2() + block_begin, count,
+                          widened[0], widened[1], widened[2]);
+        p0 = widened[0];
+        p1 = widened[1];
+        p2 = widened[2];
+      } else {
+        if (points_.getStorage() == PointStorage::Float16) {
+          widen_halves(points_.h0() + block_begin, count, widened[0]);
+          widen_halves(points_.h1() + block_begin, count, widened[1]);
+          widen_halves(points_.h2() + block_begin, count, widened[2]);
+          p0 = widened[0];
+          p1 = widened[1];
+          p2 = widened[2];
+        }
+
+        find_nearest_centroids(p0, p1, p2, count, centroids, block_assignments, nullptr);
+      }
+
+      for (size_t block_idx = 0; block_idx < count; ++block_idx) {
+        const auto point_idx = block_begin + block_idx;
+        const auto cluster_idx = block_assignments[block_idx];
+
+        moved += assignments[point_idx] != cluster_idx;
+        assignments[point_idx] = cluster_idx;
+        accumulate(accumulators, point_idx, p0[block_idx], p1[block_idx], p2[block_idx],
+                   cluster_idx);
+      }
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  return total_moved_count();
+}
@@ -0,0 +1,118 @@
+#include "MedianCut.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+struct Box {
+  size_t begin;
+  size_t end;
+  size_t split_axis;
+  float range;
+  double weight;
+};
+
+Box make_box(const ColorHistogram& histogram, const std::vector<size_t>& order, size_t begin,
+             size_t end) {
+  float min[3] = {1.0f, 1.0f, 1.0f};
+  float max[3] = {0.0f, 0.0f, 0.0f};
+  double weight = 0.0;
+
+  for (size_t idx = begin; idx < end; ++idx) {
+    const auto& color = histogram.getColor(order[idx]);
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+      min[axis] = std::min(min[axis], color[axis]);
+      max[axis] = std::max(max[axis], color[axis]);
+    }
+
+    weight += histogram.getCount(order[idx]);
+  }
+
+  size_t split_axis = 0;
+  for (size_t axis = 1; axis < 3; ++axis) {
+    if (max[axis] - min[axis] > max[split_axis] - min[split_axis]) {
+      split_axis = axis;
+    }
+  }
+
+  return Box{begin, end, split_axis, max[split_axis] - min[split_axis], weight};
+}
+
+}  // namespace
+
+std::vector<Color> median_cut_palette(const ColorHistogram& histogram, const size_t num_colors) {
+  std::vector<size_t> order(histogram.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  std::vector<Box> boxes;
+  if (!order.empty()) {
+    boxes.push_back(make_box(histogram, order, 0, order.size()));
+  }
+
+  while (boxes.size() < num_colors) {
+    // Boxes of a single color can't be split any further
+    auto box_to_split = boxes.end();
+    double best_score = 0.0;
+
+    for (auto box = boxes.begin(); box != boxes.end(); ++box) {
+      const auto score = box->weight * box->range;
+
+      if (box->end - box->begin > 1 && score > best_score) {
+        best_score = score;
+        box_to_split = box;
+      }
+    }
+
+    if (box_to_split == boxes.end()) {
+      break;
+    }
+
+    const auto box = *box_to_split;
+    const auto axis = box.split_axis;
+
+    std::sort(order.begin() + box.begin, order.begin() + box.end,
+              [&](const size_t first, const size_t second) {
+                return histogram.getColor(first)[axis] < histogram.getColor(second)[axis];
+              });
+
+    // Weighted median, both halves keep at least one color
+    double cumulative_weight = 0.0;
+    auto split = box.begin + 1;
+
+    for (size_t idx = box.begin; idx + 1 < box.end; ++idx) {
+      cumulative_weight += histogram.getCount(order[idx]);
+      split = idx + 1;
+
+      if (cumulative_weight >= 0.5 * box.weight) {
+        break;
+      }
+    }
+
+    *box_to_split = make_box(histogram, order, box.begin, split);
+    boxes.push_back(make_box(histogram, order, split, box.end));
+  }
+
+  std::vector<Color> palette;
+  palette.reserve(boxes.size());
+
+  for (const auto& box : boxes) {
+    double sums[3] = {0.0, 0.0, 0.0};
+
+    for (size_t idx = box.begin; idx < box.end; ++idx) {
+      const auto& color = histogram.getColor(order[idx]);
+      const auto count = histogram.getCount(order[idx]);
+
+      for (size_t axis = 0; axis < 3; ++axis) {
+        sums[axis] += count * color[axis];
+      }
+    }
+
+    palette.emplace_back(static_cast<float>(sums[0] / box.weight),
+                         static_cast<float>(sums[1] / box.weight),
+                         static_cast<float>(sums[2] / box.weight), ColorSpace::sRGB);
+  }
+
+  return palette;
+}
@@ -0,0 +1,159 @@
+#include "OctreeQuantizer.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+OctreeQuantizer::OctreeQuantizer(const size_t max_nodes, const bool skip_black)
+    : max_nodes_(max_nodes), skip_black_(skip_black), num_leaves_(0) {
+  if (max_nodes_ < kMinNodes) {
+    throw std::invalid_argument("Octree needs room for at least " + std::to_string(kMinNodes) +
+                                " nodes!");
+  }
+
+  create_node(0);
+}
+
+void OctreeQuantizer::consume(const unsigned char* rgb, const size_t num_pixels) {
+  for (size_t pixel_idx = 0; pixel_idx < num_pixels; ++pixel_idx) {
+    const auto r = rgb[3 * pixel_idx];
+    const auto g = rgb[3 * pixel_idx + 1];
+    const auto b = rgb[3 * pixel_idx + 2];
+
+    if (skip_black_ && r == 0 && g == 0 && b == 0) {
+      continue;
+    }
+
+    insert(r, g, b);
+
+    while (nodes_.size() - free_nodes_.size() > max_nodes_) {
+      auto& level_nodes = reducible_[deepest_reducible_level()];
+      const auto node_idx = level_nodes.back();
+      level_nodes.pop_back();
+      reduce(node_idx);
+    }
+  }
+}
+
+std::vector<Color> OctreeQuantizer::palette(const size_t num_colors) {
+  for (auto level = deepest_reducible_level(); level >= 0 && num_leaves_ > num_colors; --level) {
+    // Counts don't change anymore, so every level is sorted once and consumed from the back
+    auto& level_nodes = reducible_[level];
+    std::sort(level_nodes.begin(), level_nodes.end(),
+              [&](const int32_t first, const int32_t second) {
+                return nodes_[first].count > nodes_[second].count;
+              });
+
+    while (!level_nodes.empty() && num_leaves_ > num_colors) {
+      const auto node_idx = level_nodes.back();
+      level_nodes.pop_back();
+      reduce(node_idx);
+    }
+  }
+
+  std::vector<Color> palette;
+  std::vector<int32_t> stack{0};
+
+  while (!stack.empty()) {
+    const auto& node = nodes_[stack.back()];
+    stack.pop_back();
+
+    if (node.is_leaf) {
+      if (node.count > 0) {
+        const auto f = 1.0f / (255.0f * node.count);
+        palette.emplace_back(node.r * f, node.g * f, node.b * f);
+      }
+      continue;
+    }
+
+    for (const auto child_idx : node.children) {
+      if (child_idx >= 0) {
+        stack.push_back(child_idx);
+      }
+    }
+  }
+
+  return palette;
+}
+
+void OctreeQuantizer::insert(const unsigned char r, const unsigned char g, const unsigned char b) {
+  int32_t node_idx = 0;
+
+  for (unsigned int level = 0; !nodes_[node_idx].is_leaf; ++level) {
+    nodes_[node_idx].count += 1;
+
+    const auto shift = kMaxDepth - 1 - level;
+    const auto octant = (((r >> shift) & 1) << 2) | (((g >> shift) & 1) << 1) | ((b >> shift) & 1);
+
+    auto child_idx = nodes_[node_idx].children[octant];
+    if (child_idx < 0) {
+      // Creating a node may reallocate the pool, so the parent is looked up again afterwards
+      child_idx = create_node(level + 1);
+      nodes_[node_idx].children[octant] = child_idx;
+    }
+
+    node_idx = child_idx;
+  }
+
+  auto& leaf = nodes_[node_idx];
+  leaf.r += r;
+  leaf.g += g;
+  leaf.b += b;
+  leaf.count += 1;
+}
+
+int32_t OctreeQuantizer::create_node(const unsigned int level) {
+  int32_t node_idx;
+  if (free_nodes_.empty()) {
+    node_idx = static_cast<int32_t>(nodes_.size());
+    nodes_.emplace_back();
+  } else {
+    node_idx = free_nodes_.back();
+    free_nodes_.pop_back();
+  }
+
+  auto& node = nodes_[node_idx];
+  node = Node{};
+  node.children.fill(-1);
+  node.is_leaf = level == kMaxDepth;
+
+  if (node.is_leaf) {
+    ++num_leaves_;
+  } else {
+    reducible_[level].push_back(node_idx);
+  }
+
+  return node_idx;
+}
+
+int32_t OctreeQuantizer::deepest_reducible_level() const {
+  auto level = static_cast<int32_t>(kMaxDepth) - 1;
+  while (level > 0 && reducible_[level].empty()) {
+    --level;
+  }
+
+  return level;
+}
+
+void OctreeQuantizer::reduce(const int32_t node_idx) {
+  auto& node = nodes_[node_idx];
+
+  // Leaves are merged into their parent, which becomes a leaf itself
+  for (auto& child_idx : node.children) {
+    if (child_idx < 0) {
+      continue;
+    }
+
+    const auto& child = nodes_[child_idx];
+    node.r += child.r;
+    node.g += child.g;
+    node.b += child.b;
+
+    free_nodes_.push_back(child_idx);
+    --num_leaves_;
+    child_idx = -1;
+  }
+
+  node.is_leaf = true;
+  ++num_leaves_;
+}
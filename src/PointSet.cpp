@@ -0,0 +1,141 @@
+#include "PointSet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ColorHistogram.hpp"
+#include "Image.hpp"
+#include "RNG.hpp"
+
+PointSet PointSet::fromImage(const Image& image, const ColorSpace color_space,
+                             const bool skip_black, const PointStorage storage,
+                             const ConversionAccuracy accuracy) {
+  const size_t width = image.getWidth();
+
+  PointSet points{color_space, false, storage};
+  points.reserve(width * image.getHeight());
+
+  // Every row is converted in one batch
+  std::vector<float> c0(width);
+  std::vector<float> c1(width);
+  std::vector<float> c2(width);
+
+  for (size_t y = 0; y < image.getHeight(); ++y) {
+    const auto* row = image.getData() + 3 * y * width;
+    convert_colors(image.getColorSpace(), color_space, row, width, c0.data(), c1.data(),
+                   c2.data(), accuracy);
+
+    for (size_t x = 0; x < width; ++x) {
+      if (skip_black) {
+        if (row[3 * x] == 0.0f && row[3 * x + 1] == 0.0f && row[3 * x + 2] == 0.0f) {
+          continue;
+        }
+      }
+
+      points.add(Color{c0[x], c1[x], c2[x], color_space});
+    }
+  }
+
+  return points;
+}
+
+PointSet PointSet::fromImageStratified(const Image& image, const ColorSpace color_space,
+                                       const bool skip_black, const size_t num_samples, RNG& rng,
+                                       const PointStorage storage,
+                                       const ConversionAccuracy accuracy) {
+  const size_t width = image.getWidth();
+  const size_t height = image.getHeight();
+
+  if (num_samples >= width * height) {
+    return fromImage(image, color_space, skip_black, storage, accuracy);
+  }
+
+  const auto cell_size = std::sqrt(static_cast<double>(width * height) / num_samples);
+  const auto num_columns = std::clamp<size_t>(std::lround(width / cell_size), 1, width);
+  const auto num_rows = std::clamp<size_t>(std::lround(height / cell_size), 1, height);
+
+  PointSet points{color_space, false, storage};
+  points.reserve(num_columns * num_rows);
+
+  // Samples are drawn first and converted in one batch
+  std::vector<float> c0;
+  std::vector<float> c1;
+  std::vector<float> c2;
+  c0.reserve(num_columns * num_rows);
+  c1.reserve(num_columns * num_rows);
+  c2.reserve(num_columns * num_rows);
+
+  for (size_t row = 0; row < num_rows; ++row) {
+    const auto y_begin = row * height / num_rows;
+    const auto y_end = (row + 1) * height / num_rows;
+
+    for (size_t column = 0; column < num_columns; ++column) {
+      const auto x_begin = column * width / num_columns;
+      const auto x_end = (column + 1) * width / num_columns;
+
+      const auto x = x_begin + rng.getIndex(x_end - x_begin);
+      const auto y = y_begin + rng.getIndex(y_end - y_begin);
+      const auto& color = image.getPixel(x, y);
+
+      if (skip_black) {
+        if (color.r == 0.0f && color.g == 0.0f && color.b == 0.0f) {
+          continue;
+        }
+      }
+
+      c0.push_back(color.r);
+      c1.push_back(color.g);
+      c2.push_back(color.b);
+    }
+  }
+
+  convert_colors(image.getColorSpace(), color_space, c0.data(), c1.data(), c2.data(),
+                 c0.size(), accuracy);
+
+  for (size_t sample_idx = 0; sample_idx < c0.size(); ++sample_idx) {
+    points.add(Color{c0[sample_idx], c1[sample_idx], c2[sample_idx], color_space});
+  }
+
+  return points;
+}
+
+PointSet PointSet::fromHistogram(const ColorHistogram& histogram, const ColorSpace color_space,
+                                 const PointStorage storage,
+                                 const ConversionAccuracy accuracy) {
+  PointSet points{color_space, true, storage};
+  points.reserve(histogram.size());
+
+  std::vector<float> c0(histogram.size());
+  std::vector<float> c1(histogram.size());
+  std::vector<float> c2(histogram.size());
+
+  // Exact 8-bit colors are decoded with the table, like the pixels of an image loaded as linear
+  // sRGB, so both paths give the same points
+  const auto decode = histogram.getBitsPerChannel() == 8 && color_space != ColorSpace::sRGB;
+  const auto source_space = decode ? ColorSpace::sRGBLinear : ColorSpace::sRGB;
+
+  for (size_t bin_idx = 0; bin_idx < histogram.size(); ++bin_idx) {
+    const auto& color = histogram.getColor(bin_idx);
+
+    if (decode) {
+      c0[bin_idx] = kSrgbDecodeTable[std::lround(255.0f * color.r)];
+      c1[bin_idx] = kSrgbDecodeTable[std::lround(255.0f * color.g)];
+      c2[bin_idx] = kSrgbDecodeTable[std::lround(255.0f * color.b)];
+    } else {
+      c0[bin_idx] = color.r;
+      c1[bin_idx] = color.g;
+      c2[bin_idx] = color.b;
+    }
+  }
+
+  convert_colors(source_space, color_space, c0.data(), c1.data(), c2.data(), c0.size(),
+                 accuracy);
+
+  for (size_t bin_idx = 0; bin_idx < histogram.size(); ++bin_idx) {
+    points.add(Color{c0[bin_idx], c1[bin_idx], c2[bin_idx], color_space},
+               histogram.getCount(bin_idx));
+  }
+
+  return points;
+}
@@ -0,0 +1,346 @@
+#include "Seeding.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "NearestCentroid.hpp"
+#include "WuQuantizer.hpp"
+
+namespace {
+
+constexpr size_t kOversamplingRounds = 5;
+// Colors are split into fixed blocks with their own generator in the oversampling rounds, so the
+// sampled candidates don't depend on the number of threads
+constexpr size_t kSamplingBlockSize = 4096;
+
+// Lowers min_distances to the distance to center where it is closer and returns the weighted sum
+// of the updated distances
+double update_min_distances(const PointSet& points, const Color& center,
+                            std::vector<float>& min_distances, ThreadPool& thread_pool) {
+  std::vector<double> thread_costs(thread_pool.num_threads(), 0.0);
+
+  thread_pool.parallel_for(points.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    double cost = 0.0;
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      const auto distance = points[point_idx].distance(center);
+      min_distances[point_idx] = std::min(min_distances[point_idx], distance);
+      cost += points.weight(point_idx) * min_distances[point_idx];
+    }
+
+    thread_costs[thread_idx] = cost;
+  });
+
+  return std::accumulate(thread_costs.begin(), thread_costs.end(), 0.0);
+}
+
+// Draws an index with probability proportional to weight * min_distance, cost is the total
+size_t sample_by_cost(const PointSet& points, const std::vector<float>& min_distances,
+                      const double cost, RNG& rng) {
+  const auto target = rng.getReal() * cost;
+  double cumulative_cost = 0.0;
+
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    cumulative_cost += points.weight(point_idx) * min_distances[point_idx];
+
+    if (cumulative_cost > target) {
+      return point_idx;
+    }
+  }
+
+  // Rounding can leave the target just above the final sum, fall back to the last useful color
+  for (size_t point_idx = points.size(); point_idx > 0; --point_idx) {
+    if (min_distances[point_idx - 1] > 0.0f) {
+      return point_idx - 1;
+    }
+  }
+
+  return rng.getIndex(points.size());
+}
+
+size_t sample_by_weight(const PointSet& points, RNG& rng) {
+  if (!points.isWeighted()) {
+    return rng.getIndex(points.size());
+  }
+
+  const auto target = rng.getReal() * points.getTotalWeight();
+  double cumulative_weight = 0.0;
+
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    cumulative_weight += points.weight(point_idx);
+
+    if (cumulative_weight > target) {
+      return point_idx;
+    }
+  }
+
+  return points.size() - 1;
+}
+
+}  // namespace
+
+std::vector<Color> seed_random(const PointSet& points, const size_t num_clusters, RNG& rng) {
+  std::vector<size_t> initial_indices;
+
+  if (!points.isWeighted()) {
+    std::vector<size_t> color_indices(points.size());
+    std::iota(color_indices.begin(), color_indices.end(), 0);
+
+    std::sample(color_indices.begin(), color_indices.end(), std::back_inserter(initial_indices),
+                num_clusters, rng.getEngine());
+  } else {
+    // Weighted sampling without replacement (Efraimidis-Spirakis): keep the colors with the
+    // largest u^(1/w) keys, which picks colors as if individual pixels were sampled
+    std::vector<std::pair<double, size_t>> keys;
+    keys.reserve(points.size());
+
+    for (size_t color_idx = 0; color_idx < points.size(); ++color_idx) {
+      const double u = std::max(rng.getReal(), std::numeric_limits<float>::min());
+      keys.emplace_back(std::log(u) / points.weight(color_idx), color_idx);
+    }
+
+    const auto num_selected = std::min(num_clusters, keys.size());
+    std::partial_sort(keys.begin(), keys.begin() + num_selected, keys.end(),
+                      std::greater<std::pair<double, size_t>>());
+
+    for (size_t key_idx = 0; key_idx < num_selected; ++key_idx) {
+      initial_indices.push_back(keys[key_idx].second);
+    }
+
+    std::sort(initial_indices.begin(), initial_indices.end());
+  }
+
+  std::vector<Color> clusters;
+  clusters.reserve(initial_indices.size());
+
+  for (const auto color_idx : initial_indices) {
+    clusters.emplace_back(points[color_idx]);
+  }
+
+  return clusters;
+}
+
+std::vector<Color> seed_kmeanspp(const PointSet& points, const size_t num_clusters, RNG& rng,
+                                 ThreadPool& thread_pool) {
+  std::vector<Color> clusters;
+
+  if (points.empty() || num_clusters == 0) {
+    return clusters;
+  }
+
+  clusters.reserve(num_clusters);
+  clusters.emplace_back(points[sample_by_weight(points, rng)]);
+
+  std::vector<float> min_distances(points.size(), std::numeric_limits<float>::max());
+  auto cost = update_min_distances(points, clusters.back(), min_distances, thread_pool);
+
+  while (clusters.size() < num_clusters) {
+    // Every color coincides with a center already, further centers would be duplicates
+    if (cost <= 0.0) {
+      break;
+    }
+
+    clusters.emplace_back(points[sample_by_cost(points, min_distances, cost, rng)]);
+    cost = update_min_distances(points, clusters.back(), min_distances, thread_pool);
+  }
+
+  return clusters;
+}
+
+std::vector<Color> seed_kmeans_parallel(const PointSet& points, const size_t num_clusters, RNG& rng,
+                                        ThreadPool& thread_pool) {
+  if (points.empty() || num_clusters == 0) {
+    return {};
+  }
+
+  const double oversampling = 2.0 * num_clusters;
+  const auto num_blocks = (points.size() + kSamplingBlockSize - 1) / kSamplingBlockSize;
+
+  std::vector<Color> candidates;
+  candidates.emplace_back(points[sample_by_weight(points, rng)]);
+
+  std::vector<float> min_distances(points.size(), std::numeric_limits<float>::max());
+  auto cost = update_min_distances(points, candidates.back(), min_distances, thread_pool);
+
+  std::vector<std::vector<size_t>> block_samples(num_blocks);
+
+  for (size_t round = 0; round < kOversamplingRounds && cost > 0.0; ++round) {
+    const auto round_seed = rng.getIndex(std::numeric_limits<uint32_t>::max());
+
+    thread_pool.parallel_for(num_blocks, [&](size_t, size_t begin, size_t end) {
+      for (size_t block_idx = begin; block_idx < end; ++block_idx) {
+        RNG block_rng{round_seed * num_blocks + block_idx};
+        auto& samples = block_samples[block_idx];
+        samples.clear();
+
+        const auto block_end = std::min(points.size(), (block_idx + 1) * kSamplingBlockSize);
+        for (size_t point_idx = block_idx * kSamplingBlockSize; point_idx < block_end;
+             ++point_idx) {
+          const auto probability =
+              oversampling * points.weight(point_idx) * min_distances[point_idx] / cost;
+
+          if (block_rng.getReal() < probability) {
+            samples.push_back(point_idx);
+          }
+        }
+      }
+    });
+
+    CentroidSet round_centers;
+    std::vector<Color> round_candidates;
+    for (const auto& samples : block_samples) {
+      for (const auto point_idx : samples) {
+        round_candidates.emplace_back(points[point_idx]);
+      }
+    }
+
+    if (round_candidates.empty()) {
+      continue;
+    }
+
+    round_centers.assign(round_candidates);
+    candidates.insert(candidates.end(), round_candidates.begin(), round_candidates.end());
+
+    // Distances to all candidates of the round at once with the assignment kernel
+    std::vector<double> thread_costs(thread_pool.num_threads(), 0.0);
+    thread_pool.parallel_for(points.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+      constexpr size_t kBlockSize = 512;
+      uint32_t assignments[kBlockSize];
+      float distances[kBlockSize];
+      double thread_cost = 0.0;
+
+      for (size_t block_begin = begin; block_begin < end; block_begin += kBlockSize) {
+        const auto block_end = std::min(end, block_begin + kBlockSize);
+        find_nearest_centroids(points, block_begin, block_end, round_centers, assignments,
+                               distances);
+
+        for (size_t point_idx = block_begin; point_idx < block_end; ++point_idx) {
+          auto& min_distance = min_distances[point_idx];
+          min_distance = std::min(min_distance, distances[point_idx - block_begin]);
+          thread_cost += points.weight(point_idx) * min_distance;
+        }
+      }
+
+      thread_costs[thread_idx] = thread_cost;
+    });
+
+    cost = std::accumulate(thread_costs.begin(), thread_costs.end(), 0.0);
+  }
+
+  if (candidates.size() <= num_clusters) {
+    return candidates;
+  }
+
+  // Weight every candidate by the colors closest to it
+  CentroidSet candidate_centers;
+  candidate_centers.assign(candidates);
+
+  std::vector<std::vector<double>> thread_weights(thread_pool.num_threads(),
+                                                  std::vector<double>(candidates.size(), 0.0));
+  thread_pool.parallel_for(points.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    constexpr size_t kBlockSize = 512;
+    uint32_t assignments[kBlockSize];
+    auto& weights = thread_weights[thread_idx];
+
+    for (size_t block_begin = begin; block_begin < end; block_begin += kBlockSize) {
+      const auto block_end = std::min(end, block_begin + kBlockSize);
+      find_nearest_centroids(points, block_begin, block_end, candidate_centers, assignments,
+                             nullptr);
+
+      for (size_t point_idx = block_begin; point_idx < block_end; ++point_idx) {
+        weights[assignments[point_idx - block_begin]] += points.weight(point_idx);
+      }
+    }
+  });
+
+  PointSet weighted_candidates{points.getColorSpace(), true};
+  weighted_candidates.reserve(candidates.size());
+
+  for (size_t candidate_idx = 0; candidate_idx < candidates.size(); ++candidate_idx) {
+    double weight = 0.0;
+    for (const auto& weights : thread_weights) {
+      weight += weights[candidate_idx];
+    }
+
+    if (weight > 0.0) {
+      weighted_candidates.add(candidates[candidate_idx], weight);
+    }
+  }
+
+  ThreadPool single_thread{1};
+  return seed_kmeanspp(weighted_candidates, num_clusters, rng, single_thread);
+}
+
+std::vector<Color> seed_wu(const PointSet& points, const size_t num_clusters,
+                           ThreadPool& thread_pool) {
+  if (points.empty() || num_clusters == 0) {
+    return {};
+  }
+
+  // Converting back to sRGB is the expensive part, so every thread fills its own moment tables
+  std::vector<uint32_t> cells(points.size());
+  std::vector<WuQuantizer> thread_quantizers(thread_pool.num_threads());
+
+  thread_pool.parallel_for(points.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& quantizer = thread_quantizers[thread_idx];
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      const auto color = points[point_idx].convertTo(ColorSpace::sRGB);
+      cells[point_idx] = WuQuantizer::cell_index(color);
+      quantizer.add(cells[point_idx], color, points.weight(point_idx));
+    }
+  });
+
+  auto& quantizer = thread_quantizers[0];
+  for (size_t thread_idx = 1; thread_idx < thread_quantizers.size(); ++thread_idx) {
+    quantizer.merge(thread_quantizers[thread_idx]);
+  }
+
+  const auto num_boxes = quantizer.split(num_clusters);
+
+  // Centers are averaged in the working color space rather than converted from the sRGB means
+  std::vector<double> sums(4 * num_boxes, 0.0);
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    const auto box_idx = quantizer.box_index(cells[point_idx]);
+    const auto weight = points.weight(point_idx);
+    const auto point = points[point_idx];
+
+    sums[4 * box_idx] += weight * point.r;
+    sums[4 * box_idx + 1] += weight * point.g;
+    sums[4 * box_idx + 2] += weight * point.b;
+    sums[4 * box_idx + 3] += weight;
+  }
+
+  std::vector<Color> clusters;
+  clusters.reserve(num_boxes);
+
+  for (size_t box_idx = 0; box_idx < num_boxes; ++box_idx) {
+    const auto weight = sums[4 * box_idx + 3];
+    clusters.emplace_back(static_cast<float>(sums[4 * box_idx] / weight),
+                          static_cast<float>(sums[4 * box_idx + 1] / weight),
+                          static_cast<float>(sums[4 * box_idx + 2] / weight),
+                          points.getColorSpace());
+  }
+
+  return clusters;
+}
+
+std::vector<Color> seed_clusters(const SeedingMethod method, const PointSet& points,
+                                 const size_t num_clusters, RNG& rng, ThreadPool& thread_pool) {
+  switch (method) {
+    case SeedingMethod::Random:
+      return seed_random(points, num_clusters, rng);
+    case SeedingMethod::KMeansPlusPlus:
+      return seed_kmeanspp(points, num_clusters, rng, thread_pool);
+    case SeedingMethod::KMeansParallel:
+      return seed_kmeans_parallel(points, num_clusters, rng, thread_pool);
+    case SeedingMethod::Wu:
+      return seed_wu(points, num_clusters, thread_pool);
+    default:
+      throw std::runtime_error("Unsupported seeding method!");
+  }
+}
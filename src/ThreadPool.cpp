@@ -0,0 +1,88 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(const size_t num_threads)
+    : task_(nullptr), count_(0), generation_(0), pending_workers_(0), stop_(false) {
+  const auto num_workers = std::max<size_t>(num_threads, 1) - 1;
+  workers_.reserve(num_workers);
+
+  for (size_t worker_idx = 0; worker_idx < num_workers; ++worker_idx) {
+    workers_.emplace_back([this, worker_idx]() { worker_loop(worker_idx + 1); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+  }
+
+  work_available_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallel_for(const size_t count, const Task& task) {
+  if (workers_.empty()) {
+    task(0, 0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    task_ = &task;
+    count_ = count;
+    pending_workers_ = workers_.size();
+    generation_ += 1;
+  }
+
+  work_available_.notify_all();
+  run_chunk(0);
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  work_done_.wait(lock, [this]() { return pending_workers_ == 0; });
+  task_ = nullptr;
+}
+
+size_t ThreadPool::default_num_threads() {
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void ThreadPool::worker_loop(const size_t thread_idx) {
+  size_t seen_generation = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      work_available_.wait(lock, [&]() { return stop_ || generation_ != seen_generation; });
+
+      if (stop_) {
+        return;
+      }
+
+      seen_generation = generation_;
+    }
+
+    run_chunk(thread_idx);
+
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      pending_workers_ -= 1;
+    }
+
+    work_done_.notify_one();
+  }
+}
+
+void ThreadPool::run_chunk(const size_t thread_idx) const {
+  const auto chunk_size = (count_ + num_threads() - 1) / num_threads();
+  const auto begin = std::min(count_, thread_idx * chunk_size);
+  const auto end = std::min(count_, begin + chunk_size);
+
+  if (begin < end) {
+    (*task_)(thread_idx, begin, end);
+  }
+}
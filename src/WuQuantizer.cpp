@@ -0,0 +1,259 @@
+#include "WuQuantizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+WuQuantizer::WuQuantizer() : squares_(kNumCells, 0.0) {
+  for (auto& moment : moments_) {
+    moment.assign(kNumCells, 0.0);
+  }
+}
+
+uint32_t WuQuantizer::cell_index(const Color& color) {
+  uint32_t cell[3];
+
+  for (size_t axis = 0; axis < 3; ++axis) {
+    const auto value = std::clamp<long>(std::lround(color[axis] * 255.0f), 0, 255);
+    cell[axis] = (static_cast<uint32_t>(value) >> 3) + 1;
+  }
+
+  return index(cell[0], cell[1], cell[2]);
+}
+
+void WuQuantizer::add(const uint32_t cell_idx, const Color& color, const double weight) {
+  moments_[kWeight][cell_idx] += weight;
+  moments_[kR][cell_idx] += weight * color.r;
+  moments_[kG][cell_idx] += weight * color.g;
+  moments_[kB][cell_idx] += weight * color.b;
+  squares_[cell_idx] += weight * (color.r * color.r + color.g * color.g + color.b * color.b);
+}
+
+void WuQuantizer::merge(const WuQuantizer& other) {
+  for (size_t moment_idx = 0; moment_idx < kNumMoments; ++moment_idx) {
+    for (uint32_t cell_idx = 0; cell_idx < kNumCells; ++cell_idx) {
+      moments_[moment_idx][cell_idx] += other.moments_[moment_idx][cell_idx];
+    }
+  }
+
+  for (uint32_t cell_idx = 0; cell_idx < kNumCells; ++cell_idx) {
+    squares_[cell_idx] += other.squares_[cell_idx];
+  }
+}
+
+size_t WuQuantizer::split(const size_t num_boxes) {
+  compute_cumulative_moments();
+
+  const auto last = kGridSize - 1;
+  boxes_.assign(1, Box{{0, 0, 0}, {last, last, last}, last * last * last});
+
+  if (num_boxes == 0 || volume(boxes_[0], moments_[kWeight]) <= 0.0) {
+    boxes_.clear();
+  }
+
+  std::vector<double> variances;
+  if (!boxes_.empty()) {
+    variances.push_back(variance(boxes_[0]));
+  }
+
+  size_t next = 0;
+  while (!boxes_.empty() && boxes_.size() < num_boxes) {
+    Box new_box{};
+
+    if (cut(boxes_[next], new_box)) {
+      boxes_.push_back(new_box);
+      variances[next] = boxes_[next].volume > 1 ? variance(boxes_[next]) : 0.0;
+      variances.push_back(new_box.volume > 1 ? variance(new_box) : 0.0);
+    } else {
+      variances[next] = 0.0;
+    }
+
+    next = static_cast<size_t>(std::max_element(variances.begin(), variances.end()) -
+                               variances.begin());
+    if (variances[next] <= 0.0) {
+      break;
+    }
+  }
+
+  cell_boxes_.assign(kNumCells, 0);
+  for (uint32_t box_idx = 0; box_idx < boxes_.size(); ++box_idx) {
+    const auto& box = boxes_[box_idx];
+
+    for (auto r = box.min[0] + 1; r <= box.max[0]; ++r) {
+      for (auto g = box.min[1] + 1; g <= box.max[1]; ++g) {
+        for (auto b = box.min[2] + 1; b <= box.max[2]; ++b) {
+          cell_boxes_[index(r, g, b)] = box_idx;
+        }
+      }
+    }
+  }
+
+  return boxes_.size();
+}
+
+std::vector<Color> WuQuantizer::box_means() const {
+  std::vector<Color> means;
+  means.reserve(boxes_.size());
+
+  for (const auto& box : boxes_) {
+    const auto weight = volume(box, moments_[kWeight]);
+    means.emplace_back(static_cast<float>(volume(box, moments_[kR]) / weight),
+                       static_cast<float>(volume(box, moments_[kG]) / weight),
+                       static_cast<float>(volume(box, moments_[kB]) / weight), ColorSpace::sRGB);
+  }
+
+  return means;
+}
+
+void WuQuantizer::compute_cumulative_moments() {
+  const auto accumulate = [](std::vector<double>& moment) {
+    for (uint32_t r = 1; r < kGridSize; ++r) {
+      for (uint32_t g = 1; g < kGridSize; ++g) {
+        for (uint32_t b = 1; b < kGridSize; ++b) {
+          moment[index(r, g, b)] += moment[index(r, g, b - 1)];
+        }
+      }
+    }
+
+    for (uint32_t r = 1; r < kGridSize; ++r) {
+      for (uint32_t g = 1; g < kGridSize; ++g) {
+        for (uint32_t b = 1; b < kGridSize; ++b) {
+          moment[index(r, g, b)] += moment[index(r, g - 1, b)];
+        }
+      }
+    }
+
+    for (uint32_t r = 1; r < kGridSize; ++r) {
+      for (uint32_t g = 1; g < kGridSize; ++g) {
+        for (uint32_t b = 1; b < kGridSize; ++b) {
+          moment[index(r, g, b)] += moment[index(r - 1, g, b)];
+        }
+      }
+    }
+  };
+
+  for (auto& moment : moments_) {
+    accumulate(moment);
+  }
+  accumulate(squares_);
+}
+
+double WuQuantizer::plane_sum(const Box& box, const size_t axis, const uint32_t position,
+                              const std::vector<double>& moment) const {
+  const auto axis1 = (axis + 1) % 3;
+  const auto axis2 = (axis + 2) % 3;
+
+  const auto at = [&](const uint32_t value1, const uint32_t value2) {
+    uint32_t corner[3];
+    corner[axis] = position;
+    corner[axis1] = value1;
+    corner[axis2] = value2;
+    return moment[index(corner[0], corner[1], corner[2])];
+  };
+
+  return at(box.max[axis1], box.max[axis2]) - at(box.max[axis1], box.min[axis2]) -
+         at(box.min[axis1], box.max[axis2]) + at(box.min[axis1], box.min[axis2]);
+}
+
+double WuQuantizer::volume(const Box& box, const std::vector<double>& moment) const {
+  return plane_sum(box, 0, box.max[0], moment) - plane_sum(box, 0, box.min[0], moment);
+}
+
+double WuQuantizer::variance(const Box& box) const {
+  const auto weight = volume(box, moments_[kWeight]);
+  if (weight <= 0.0) {
+    return 0.0;
+  }
+
+  const auto r = volume(box, moments_[kR]);
+  const auto g = volume(box, moments_[kG]);
+  const auto b = volume(box, moments_[kB]);
+
+  return volume(box, squares_) - (r * r + g * g + b * b) / weight;
+}
+
+double WuQuantizer::maximize(const Box& box, const size_t axis,
+                             const std::array<double, kNumMoments>& whole, uint32_t& cut) const {
+  // Moments of the lower half are the plane sum at the cut minus the one at the lower bound
+  std::array<double, kNumMoments> base;
+  for (size_t moment_idx = 0; moment_idx < kNumMoments; ++moment_idx) {
+    base[moment_idx] = -plane_sum(box, axis, box.min[axis], moments_[moment_idx]);
+  }
+
+  // Minimizing the summed variance of the halves means maximizing the sum of |m|^2 / w
+  double best = 0.0;
+  cut = 0;
+
+  for (auto position = box.min[axis] + 1; position < box.max[axis]; ++position) {
+    std::array<double, kNumMoments> half;
+    std::array<double, kNumMoments> other;
+
+    for (size_t moment_idx = 0; moment_idx < kNumMoments; ++moment_idx) {
+      half[moment_idx] = base[moment_idx] + plane_sum(box, axis, position, moments_[moment_idx]);
+      other[moment_idx] = whole[moment_idx] - half[moment_idx];
+    }
+
+    if (half[kWeight] <= 0.0 || other[kWeight] <= 0.0) {
+      continue;
+    }
+
+    const auto score =
+        (half[kR] * half[kR] + half[kG] * half[kG] + half[kB] * half[kB]) / half[kWeight] +
+        (other[kR] * other[kR] + other[kG] * other[kG] + other[kB] * other[kB]) / other[kWeight];
+
+    if (score > best) {
+      best = score;
+      cut = position;
+    }
+  }
+
+  return best;
+}
+
+bool WuQuantizer::cut(Box& box1, Box& box2) const {
+  std::array<double, kNumMoments> whole;
+  for (size_t moment_idx = 0; moment_idx < kNumMoments; ++moment_idx) {
+    whole[moment_idx] = volume(box1, moments_[moment_idx]);
+  }
+
+  size_t best_axis = 0;
+  double best_score = 0.0;
+  uint32_t best_cut = 0;
+
+  for (size_t axis = 0; axis < 3; ++axis) {
+    uint32_t axis_cut;
+    const auto score = maximize(box1, axis, whole, axis_cut);
+
+    if (axis_cut > 0 && score > best_score) {
+      best_axis = axis;
+      best_score = score;
+      best_cut = axis_cut;
+    }
+  }
+
+  // No position leaves colors on both sides
+  if (best_cut == 0) {
+    return false;
+  }
+
+  box2 = box1;
+  box1.max[best_axis] = best_cut;
+  box2.min[best_axis] = best_cut;
+
+  for (auto* box : {&box1, &box2}) {
+    box->volume =
+        (box->max[0] - box->min[0]) * (box->max[1] - box->min[1]) * (box->max[2] - box->min[2]);
+  }
+
+  return true;
+}
+
+std::vector<Color> wu_palette(const ColorHistogram& histogram, const size_t num_colors) {
+  WuQuantizer quantizer;
+
+  for (size_t color_idx = 0; color_idx < histogram.size(); ++color_idx) {
+    quantizer.add(histogram.getColor(color_idx), histogram.getCount(color_idx));
+  }
+
+  quantizer.split(num_colors);
+  return quantizer.box_means();
+}
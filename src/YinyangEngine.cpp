@@ -0,0 +1,259 @@
+#include "YinyangEngine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+constexpr size_t kClustersPerGroup = 10;
+constexpr size_t kGroupingIterations = 5;
+
+}  // namespace
+
+YinyangEngine::YinyangEngine(const PointSet& points, ThreadPool& thread_pool)
+    : ClusteringEngine(points, thread_pool),
+      num_groups_(0),
+      upper_bounds_(points.size()),
+      initialized_(false) {}
+
+size_t YinyangEngine::assign(const CentroidSet& centroids, std::vector<uint32_t>& assignments,
+                             ThreadAccumulators& thread_accumulators) {
+  if (!initialized_ || previous_centroids_.size() != centroids.size()) {
+    return initialize_bounds(centroids, assignments, thread_accumulators);
+  }
+
+  const auto num_clusters = centroids.size();
+
+  std::vector<float> shifts(num_clusters);
+  std::vector<float> group_shifts(num_groups_, 0.0f);
+
+  for (size_t cluster_idx = 0; cluster_idx < num_clusters; ++cluster_idx) {
+    shifts[cluster_idx] = centroids.distance(cluster_idx, previous_centroids_);
+
+    auto& group_shift = group_shifts[centroid_groups_[cluster_idx]];
+    group_shift = std::max(group_shift, shifts[cluster_idx]);
+  }
+
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    // Closest and second closest distance found in each group examined for the current point
+    std::vector<float> group_closest(num_groups_);
+    std::vector<float> group_second(num_groups_);
+    std::vector<uint32_t> group_closest_idx(num_groups_);
+    std::vector<uint8_t> group_examined(num_groups_);
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      auto* lower_bounds = lower_bounds_.data() + point_idx * num_groups_;
+      auto& upper_bound = upper_bounds_[point_idx];
+      const auto initial_cluster_idx = assignments[point_idx];
+
+      upper_bound += shifts[initial_cluster_idx];
+
+      float global_lower_bound = std::numeric_limits<float>::infinity();
+      for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+        lower_bounds[group_idx] -= group_shifts[group_idx];
+        global_lower_bound = std::min(global_lower_bound, lower_bounds[group_idx]);
+      }
+
+      auto cluster_idx = initial_cluster_idx;
+
+      if (!definitely_closer(upper_bound, global_lower_bound)) {
+        const auto initial_distance =
+            squared_distance(points_, point_idx, centroids, initial_cluster_idx);
+        upper_bound = std::sqrt(initial_distance);
+
+        if (!definitely_closer(upper_bound, global_lower_bound)) {
+          auto cluster_distance = initial_distance;
+
+          for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+            group_examined[group_idx] = 0;
+
+            if (definitely_closer(upper_bound, lower_bounds[group_idx])) {
+              continue;
+            }
+
+            group_examined[group_idx] = 1;
+            group_closest[group_idx] = std::numeric_limits<float>::infinity();
+            group_second[group_idx] = std::numeric_limits<float>::infinity();
+
+            for (const auto member_idx : group_members_[group_idx]) {
+              const auto distance = squared_distance(points_, point_idx, centroids, member_idx);
+
+              if (distance < group_closest[group_idx]) {
+                group_second[group_idx] = group_closest[group_idx];
+                group_closest[group_idx] = distance;
+                group_closest_idx[group_idx] = member_idx;
+              } else if (distance < group_second[group_idx]) {
+                group_second[group_idx] = distance;
+              }
+
+              // Same tie breaking as the brute force search, the lower index wins
+              if (distance < cluster_distance ||
+                  (distance == cluster_distance && member_idx < cluster_idx)) {
+                cluster_idx = member_idx;
+                cluster_distance = distance;
+                upper_bound = std::sqrt(distance);
+              }
+            }
+          }
+
+          for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+            if (group_examined[group_idx]) {
+              const auto excluded = group_closest_idx[group_idx] == cluster_idx;
+              lower_bounds[group_idx] =
+                  std::sqrt(excluded ? group_second[group_idx] : group_closest[group_idx]);
+            }
+          }
+
+          // The previously assigned centroid is no longer excluded from its group's bound
+          const auto initial_group_idx = centroid_groups_[initial_cluster_idx];
+          if (cluster_idx != initial_cluster_idx && !group_examined[initial_group_idx]) {
+            lower_bounds[initial_group_idx] =
+                std::min(lower_bounds[initial_group_idx], std::sqrt(initial_distance));
+          }
+        }
+      }
+
+      moved += initial_cluster_idx != cluster_idx;
+      assignments[point_idx] = cluster_idx;
+      accumulate(accumulators, point_idx, cluster_idx);
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  previous_centroids_ = centroids;
+  return total_moved_count();
+}
+
+void YinyangEngine::group_centroids(const CentroidSet& centroids) {
+  const auto num_clusters = centroids.size();
+  num_groups_ = std::max<size_t>(1, num_clusters / kClustersPerGroup);
+
+  // A few plain k-means iterations over the centroids themselves, seeded with evenly spaced ones
+  std::vector<float> group_centers(3 * num_groups_);
+  for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+    const auto cluster_idx = group_idx * num_clusters / num_groups_;
+    group_centers[3 * group_idx] = centroids.c0()[cluster_idx];
+    group_centers[3 * group_idx + 1] = centroids.c1()[cluster_idx];
+    group_centers[3 * group_idx + 2] = centroids.c2()[cluster_idx];
+  }
+
+  centroid_groups_.assign(num_clusters, 0);
+
+  for (size_t iteration = 0; iteration < kGroupingIterations; ++iteration) {
+    std::vector<float> sums(3 * num_groups_, 0.0f);
+    std::vector<size_t> counts(num_groups_, 0);
+
+    for (size_t cluster_idx = 0; cluster_idx < num_clusters; ++cluster_idx) {
+      float min_distance = std::numeric_limits<float>::max();
+
+      for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+        const auto d0 = centroids.c0()[cluster_idx] - group_centers[3 * group_idx];
+        const auto d1 = centroids.c1()[cluster_idx] - group_centers[3 * group_idx + 1];
+        const auto d2 = centroids.c2()[cluster_idx] - group_centers[3 * group_idx + 2];
+        const auto distance = d0 * d0 + d1 * d1 + d2 * d2;
+
+        if (distance < min_distance) {
+          min_distance = distance;
+          centroid_groups_[cluster_idx] = static_cast<uint32_t>(group_idx);
+        }
+      }
+
+      const auto group_idx = centroid_groups_[cluster_idx];
+      sums[3 * group_idx] += centroids.c0()[cluster_idx];
+      sums[3 * group_idx + 1] += centroids.c1()[cluster_idx];
+      sums[3 * group_idx + 2] += centroids.c2()[cluster_idx];
+      counts[group_idx] += 1;
+    }
+
+    for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+      if (counts[group_idx] > 0) {
+        for (size_t dimension = 0; dimension < 3; ++dimension) {
+          group_centers[3 * group_idx + dimension] =
+              sums[3 * group_idx + dimension] / counts[group_idx];
+        }
+      }
+    }
+  }
+
+  // Groups that ended up empty are dropped
+  std::vector<std::vector<uint32_t>> members(num_groups_);
+  for (size_t cluster_idx = 0; cluster_idx < num_clusters; ++cluster_idx) {
+    members[centroid_groups_[cluster_idx]].push_back(static_cast<uint32_t>(cluster_idx));
+  }
+
+  group_members_.clear();
+  for (auto& group : members) {
+    if (!group.empty()) {
+      for (const auto cluster_idx : group) {
+        centroid_groups_[cluster_idx] = static_cast<uint32_t>(group_members_.size());
+      }
+
+      group_members_.push_back(std::move(group));
+    }
+  }
+
+  num_groups_ = group_members_.size();
+}
+
+size_t YinyangEngine::initialize_bounds(const CentroidSet& centroids,
+                                        std::vector<uint32_t>& assignments,
+                                        ThreadAccumulators& thread_accumulators) {
+  group_centroids(centroids);
+  lower_bounds_.resize(points_.size() * num_groups_);
+
+  std::fill(thread_moved_counts_.begin(), thread_moved_counts_.end(), 0);
+
+  thread_pool_.parallel_for(points_.size(), [&](size_t thread_idx, size_t begin, size_t end) {
+    auto& accumulators = thread_accumulators[thread_idx];
+    size_t moved = 0;
+
+    for (size_t point_idx = begin; point_idx < end; ++point_idx) {
+      auto* lower_bounds = lower_bounds_.data() + point_idx * num_groups_;
+
+      float closest_distance = std::numeric_limits<float>::max();
+      uint32_t cluster_idx = 0;
+
+      for (size_t other_idx = 0; other_idx < centroids.size(); ++other_idx) {
+        const auto distance = squared_distance(points_, point_idx, centroids, other_idx);
+
+        if (distance < closest_distance) {
+          closest_distance = distance;
+          cluster_idx = static_cast<uint32_t>(other_idx);
+        }
+      }
+
+      for (size_t group_idx = 0; group_idx < num_groups_; ++group_idx) {
+        float group_distance = std::numeric_limits<float>::infinity();
+
+        for (const auto member_idx : group_members_[group_idx]) {
+          if (member_idx != cluster_idx) {
+            group_distance = std::min(
+                group_distance, squared_distance(points_, point_idx, centroids, member_idx));
+          }
+        }
+
+        lower_bounds[group_idx] = std::sqrt(group_distance);
+      }
+
+      moved += assignments[point_idx] != cluster_idx;
+      assignments[point_idx] = cluster_idx;
+      upper_bounds_[point_idx] = std::sqrt(closest_distance);
+
+      accumulate(accumulators, point_idx, cluster_idx);
+    }
+
+    thread_moved_counts_[thread_idx] = moved;
+  });
+
+  previous_centroids_ = centroids;
+  initialized_ = true;
+
+  return total_moved_count();
+}
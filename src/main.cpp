@@ -1,10 +1,66 @@
 #include <CLI11.hpp>
+#include <cctype>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
 
 #include "Color.hpp"
+#include "ColorHistogram.hpp"
+#include "Coreset.hpp"
 #include "Image.hpp"
 #include "KMeansClustering.hpp"
+#include "KdTreeEngine.hpp"
+#include "MedianCut.hpp"
+#include "OctreeQuantizer.hpp"
+#include "PointSet.hpp"
 #include "RNG.hpp"
+#include "ThreadPool.hpp"
+#include "WuQuantizer.hpp"
+
+// Palette methods that don't run k-means themselves, their result can be refined with a few Lloyd
+// iterations afterwards
+enum class PaletteQuantizer { None, MedianCut, Octree, Wu };
+
+// Index of the candidate at the knee of the inertia curve (Kneedle): the point farthest below the
+// chord between the first and the last candidate, both axes normalized to [0, 1]. The curve starts
+// at K = 2, the inertia of a single cluster is so large that it would flatten the rest of the
+// curve and put the knee at K = 2 or 3 for almost every image.
+size_t select_by_elbow(const std::vector<double>& inertias) {
+  constexpr size_t kFirstIdx = 1;
+
+  if (inertias.size() < kFirstIdx + 3) {
+    return inertias.size() - 1;
+  }
+
+  const auto num_points = inertias.size() - kFirstIdx;
+  const auto inertia_range = std::max(inertias[kFirstIdx] - inertias.back(), 1e-12);
+  size_t best_idx = kFirstIdx;
+  double best_gap = -1.0;
+
+  for (size_t idx = kFirstIdx; idx < inertias.size(); ++idx) {
+    const auto x = static_cast<double>(idx - kFirstIdx) / (num_points - 1);
+    const auto y = (inertias[idx] - inertias.back()) / inertia_range;
+    const auto gap = (1.0 - x) - y;
+
+    if (gap > best_gap) {
+      best_gap = gap;
+      best_idx = idx;
+    }
+  }
+
+  return best_idx;
+}
+
+// Index of the candidate with the highest silhouette, a single cluster has none
+size_t select_by_silhouette(const std::vector<double>& silhouettes) {
+  if (silhouettes.size() < 2) {
+    return 0;
+  }
+
+  const auto best = std::max_element(silhouettes.begin() + 1, silhouettes.end());
+  return static_cast<size_t>(best - silhouettes.begin());
+}
 
 int main(int argc, char** argv) {
   CLI::App app{"Image palette generator"};
@@ -13,17 +69,72 @@ int main(int argc, char** argv) {
   std::string input_image_path{};
   app.add_option("-i,--input", input_image_path, "Input image")->required();
 
-  size_t num_clusters = 15;
-  app.add_option("-n,--num_clusters", num_clusters, "Number of clusters");
+  std::string num_clusters_str = "15";
+  app.add_option("-n,--num_clusters", num_clusters_str,
+                 "Number of clusters, or \"auto\" to pick it between 1 and --max_clusters");
+
+  size_t max_clusters = 16;
+  app.add_option("--max_clusters", max_clusters,
+                 "Largest number of clusters considered by -n auto")
+      ->check(CLI::PositiveNumber);
+
+  std::string k_criterion_name = "elbow";
+  app.add_option("--k_criterion", k_criterion_name,
+                 "Criterion used by -n auto. Available options are: elbow (default), silhouette");
+
+  size_t silhouette_samples = 1000;
+  app.add_option("--silhouette_samples", silhouette_samples,
+                 "Number of colors sampled to estimate the silhouette for -n auto")
+      ->check(CLI::PositiveNumber);
 
   size_t num_iterations = 10;
-  app.add_option("--iters", num_iterations, "Number of clustering iterations");
+  app.add_option("--iters", num_iterations, "Maximum number of clustering iterations");
+
+  float tolerance = 0.0f;
+  app.add_option("--tolerance", tolerance,
+                 "Stop clustering once no cluster center moves by more than this distance in the "
+                 "working color space");
+
+  float min_moved_fraction = 0.0f;
+  app.add_option("--min_moved_fraction", min_moved_fraction,
+                 "Stop clustering once at most this fraction of colors changes its cluster (not "
+                 "available with --minibatch)");
+
+  std::string algorithm_name = "lloyd";
+  app.add_option("--algorithm", algorithm_name,
+                 "Clustering algorithm. Available options are: lloyd (default), hamerly, elkan, "
+                 "yinyang, kdtree, mediancut, octree, wu");
+
+  size_t refine_iterations = 0;
+  app.add_option("--refine_iters", refine_iterations,
+                 "Number of Lloyd iterations used to refine the palette found by mediancut, "
+                 "octree or wu");
+
+  size_t octree_nodes = OctreeQuantizer::kDefaultMaxNodes;
+  app.add_option("--octree_nodes", octree_nodes,
+                 "Maximum number of nodes kept by the octree while the image is being loaded")
+      ->check(CLI::Range(OctreeQuantizer::kMinNodes, std::numeric_limits<size_t>::max()));
+
+  std::string init_name = "random";
+  app.add_option("--init", init_name,
+                 "Method used to pick initial cluster centers. Available options are: random "
+                 "(default), kmeanspp, kmeansparallel, wu");
 
   std::string color_space_name = "oklab";
   app.add_option("--color_space", color_space_name,
                  "Color space in which clustering will be performed. Available options are: "
                  "linear_srgb, srgb, rgG, xyz, oklab (default)");
 
+  std::string storage_name = "f32";
+  app.add_option("--storage", storage_name,
+                 "Precision in which colors are stored for clustering. Available options are: f32 "
+                 "(default), f16, i16 (fixed point, srgb and linear_srgb only). Packed storage is "
+                 "only supported by lloyd");
+
+  bool fast_math = false;
+  app.add_flag("--fast_math", fast_math,
+               "Convert colors into oklab with a faster cube root, accurate to about 2e-6");
+
   size_t padding = 5;
   app.add_option("--padding", padding, "Padding between elements on output image");
 
@@ -46,6 +157,51 @@ int main(int argc, char** argv) {
   app.add_flag("--dont_skip_black", dont_skip_black,
                "Will include black pixels in clustering when set to true");
 
+  size_t minibatch_size = 0;
+  app.add_option("--minibatch", minibatch_size,
+                 "Use mini-batch k-means with batches of the given size (0 disables it)");
+
+  bool minibatch_final_pass = false;
+  app.add_flag("--minibatch_final_pass", minibatch_final_pass,
+               "Finish mini-batch k-means with one full assignment pass over all colors");
+
+  bool use_histogram = false;
+  app.add_flag("--histogram", use_histogram,
+               "Cluster distinct colors weighted by their pixel counts instead of every pixel");
+
+  unsigned int quantize_bits = 0;
+  app.add_option("--quantize_bits", quantize_bits,
+                 "Bin colors into a coarser grid with the given number of bits per channel while "
+                 "loading and cluster the mean colors of the bins (0 disables it)")
+      ->check(CLI::IsMember({0, 4, 5, 6}));
+
+  size_t num_samples = 0;
+  app.add_option("--sample", num_samples,
+                 "Cluster about this many pixels picked by stratified sampling over the image "
+                 "instead of all of them (0 disables it)");
+
+  size_t coreset_size = 0;
+  app.add_option("--coreset", coreset_size,
+                 "Cluster a weighted coreset of this many colors built by sensitivity sampling "
+                 "(0 disables it)");
+
+  std::string save_coreset_path{};
+  app.add_option("--save_coreset", save_coreset_path,
+                 "Save the colors that are clustered, e.g. the coreset, to a file");
+
+  std::string load_coreset_path{};
+  app.add_option("--load_coreset", load_coreset_path,
+                 "Cluster colors saved by --save_coreset instead of the colors of the input image");
+
+  size_t num_restarts = 1;
+  app.add_option("--restarts", num_restarts,
+                 "Number of independent clustering runs, the one with the lowest inertia is kept")
+      ->check(CLI::PositiveNumber);
+
+  size_t num_threads = ThreadPool::default_num_threads();
+  app.add_option("--threads", num_threads,
+                 "Number of worker threads used for clustering (defaults to hardware concurrency)");
+
   std::string output_file_name = "palette.png";
   app.add_option("-o,--output", output_file_name, "Output image");
 
@@ -71,6 +227,167 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  PointStorage storage = PointStorage::Float32;
+  std::transform(storage_name.begin(), storage_name.end(), storage_name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (storage_name == "f32") {
+    storage = PointStorage::Float32;
+  } else if (storage_name == "f16") {
+    storage = PointStorage::Float16;
+  } else if (storage_name == "i16") {
+    storage = PointStorage::Fixed16;
+  } else {
+    std::cerr << "ERROR: Unrecognized storage (" << storage_name
+              << ")! Use one of the following: f32, f16, i16" << std::endl;
+    return 1;
+  }
+
+  // Fixed point covers [0, 1], which only the RGB spaces are guaranteed to stay in
+  if (storage == PointStorage::Fixed16 && working_color_space != ColorSpace::sRGB &&
+      working_color_space != ColorSpace::sRGBLinear) {
+    std::cerr << "ERROR: i16 storage is only supported by the srgb and linear_srgb color spaces"
+              << std::endl;
+    return 1;
+  }
+
+  const auto accuracy = fast_math ? ConversionAccuracy::Fast : ConversionAccuracy::Accurate;
+
+  ClusteringAlgorithm algorithm = ClusteringAlgorithm::Lloyd;
+  PaletteQuantizer quantizer = PaletteQuantizer::None;
+  std::transform(algorithm_name.begin(), algorithm_name.end(), algorithm_name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (algorithm_name == "lloyd") {
+    algorithm = ClusteringAlgorithm::Lloyd;
+  } else if (algorithm_name == "hamerly") {
+    algorithm = ClusteringAlgorithm::Hamerly;
+  } else if (algorithm_name == "elkan") {
+    algorithm = ClusteringAlgorithm::Elkan;
+  } else if (algorithm_name == "yinyang") {
+    algorithm = ClusteringAlgorithm::Yinyang;
+  } else if (algorithm_name == "kdtree") {
+    algorithm = ClusteringAlgorithm::KdTree;
+  } else if (algorithm_name == "mediancut") {
+    quantizer = PaletteQuantizer::MedianCut;
+  } else if (algorithm_name == "octree") {
+    quantizer = PaletteQuantizer::Octree;
+  } else if (algorithm_name == "wu") {
+    quantizer = PaletteQuantizer::Wu;
+  } else {
+    std::cerr << "ERROR: Unrecognized clustering algorithm (" << algorithm_name
+              << ")! Use one of the following: lloyd, hamerly, elkan, yinyang, kdtree, "
+                 "mediancut, octree, wu"
+              << std::endl;
+    return 1;
+  }
+
+  if (storage != PointStorage::Float32 && quantizer == PaletteQuantizer::None &&
+      algorithm != ClusteringAlgorithm::Lloyd) {
+    std::cerr << "ERROR: " << storage_name << " storage is only supported by the lloyd algorithm"
+              << std::endl;
+    return 1;
+  }
+
+  SeedingMethod seeding = SeedingMethod::Random;
+  std::transform(init_name.begin(), init_name.end(), init_name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (init_name == "random") {
+    seeding = SeedingMethod::Random;
+  } else if (init_name == "kmeanspp") {
+    seeding = SeedingMethod::KMeansPlusPlus;
+  } else if (init_name == "kmeansparallel") {
+    seeding = SeedingMethod::KMeansParallel;
+  } else if (init_name == "wu") {
+    seeding = SeedingMethod::Wu;
+  } else {
+    std::cerr << "ERROR: Unrecognized initialization method (" << init_name
+              << ")! Use one of the following: random, kmeanspp, kmeansparallel, wu" << std::endl;
+    return 1;
+  }
+
+  const auto auto_num_clusters = num_clusters_str == "auto";
+  size_t num_clusters = 0;
+
+  if (!auto_num_clusters) {
+    // Only a positive number that makes up the whole string, std::stoul would accept "5x" and wrap
+    // negative numbers around
+    size_t parsed_length = 0;
+    try {
+      const auto starts_with_digit = !num_clusters_str.empty() &&
+                                     std::isdigit(static_cast<unsigned char>(num_clusters_str[0]));
+      if (starts_with_digit) {
+        num_clusters = std::stoul(num_clusters_str, &parsed_length);
+      }
+    } catch (std::exception&) {
+      parsed_length = 0;
+    }
+
+    if (parsed_length != num_clusters_str.size() || num_clusters == 0) {
+      std::cerr << "ERROR: Invalid number of clusters (" << num_clusters_str
+                << ")! Use a positive number or auto" << std::endl;
+      return 1;
+    }
+  }
+
+  std::transform(k_criterion_name.begin(), k_criterion_name.end(), k_criterion_name.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (k_criterion_name != "elbow" && k_criterion_name != "silhouette") {
+    std::cerr << "ERROR: Unrecognized criterion (" << k_criterion_name
+              << ")! Use one of the following: elbow, silhouette" << std::endl;
+    return 1;
+  }
+
+  const auto use_silhouette = k_criterion_name == "silhouette";
+
+  // Mini-batches don't assign every color, so there is no fraction of moved colors to stop on
+  if (minibatch_size > 0 && min_moved_fraction > 0.0f) {
+    std::cerr << "ERROR: --min_moved_fraction can't be combined with --minibatch" << std::endl;
+    return 1;
+  }
+
+  if (auto_num_clusters && num_restarts > 1) {
+    std::cerr << "ERROR: -n auto can't be combined with --restarts" << std::endl;
+    return 1;
+  }
+
+  if (quantizer != PaletteQuantizer::None && (auto_num_clusters || num_restarts > 1)) {
+    std::cerr << "ERROR: " << algorithm_name << " can't be combined with -n auto or --restarts"
+              << std::endl;
+    return 1;
+  }
+
+  if (quantizer != PaletteQuantizer::None && (coreset_size > 0 || !load_coreset_path.empty())) {
+    std::cerr << "ERROR: " << algorithm_name
+              << " can't be combined with --coreset or --load_coreset" << std::endl;
+    return 1;
+  }
+
+  // Quantizers read the histogram, colors are only gathered when the palette is refined
+  if (quantizer != PaletteQuantizer::None && refine_iterations == 0 && !save_coreset_path.empty()) {
+    std::cerr << "ERROR: " << algorithm_name
+              << " without --refine_iters clusters no colors that --save_coreset could save"
+              << std::endl;
+    return 1;
+  }
+
+  if (!load_coreset_path.empty() &&
+      (use_histogram || quantize_bits > 0 || num_samples > 0 || coreset_size > 0)) {
+    std::cerr << "ERROR: --load_coreset can't be combined with --histogram, --quantize_bits, "
+                 "--sample or --coreset"
+              << std::endl;
+    return 1;
+  }
+
+  // The octree is the only sink while loading, a refined octree palette clusters every pixel
+  if (quantizer == PaletteQuantizer::Octree && (use_histogram || quantize_bits > 0)) {
+    std::cerr << "ERROR: octree can't be combined with --histogram or --quantize_bits"
+              << std::endl;
+    return 1;
+  }
+
   const auto bg_color_opt = Color::parse_string(background_color_str);
 
   if (!bg_color_opt.has_value()) {
@@ -86,11 +403,191 @@ int main(int argc, char** argv) {
     rng = RNG{};
   }
 
-  Image image{input_image_path};
-  KMeansClustering clustering{rng, image, num_clusters, working_color_space, !dont_skip_black};
+  std::unique_ptr<ColorHistogram> histogram;
+  if (quantize_bits > 0) {
+    histogram = std::make_unique<ColorHistogram>(quantize_bits, !dont_skip_black);
+  } else if (use_histogram) {
+    histogram = std::make_unique<ColorHistogram>(8, !dont_skip_black);
+  } else if (quantizer == PaletteQuantizer::MedianCut || quantizer == PaletteQuantizer::Wu) {
+    // Histogram quantizers only need the color distribution, 5 bits keep it small without
+    // visible banding
+    histogram = std::make_unique<ColorHistogram>(5, !dont_skip_black);
+  }
+
+  if (num_samples > 0 && histogram) {
+    std::cerr << "ERROR: --sample can't be combined with histogram based clustering" << std::endl;
+    return 1;
+  }
+
+  std::unique_ptr<OctreeQuantizer> octree;
+  if (quantizer == PaletteQuantizer::Octree) {
+    octree = std::make_unique<OctreeQuantizer>(octree_nodes, !dont_skip_black);
+  }
+
+  PixelSink* sink = octree ? static_cast<PixelSink*>(octree.get()) : histogram.get();
+  // Every working color space but sRGB starts from linear sRGB, which the loader produces with a
+  // table lookup per component
+  const auto image_color_space =
+      working_color_space == ColorSpace::sRGB ? ColorSpace::sRGB : ColorSpace::sRGBLinear;
+  Image image{input_image_path, sink, image_color_space};
+
+  // Quantizers work on the histogram directly, colors are only needed when k-means runs
+  std::shared_ptr<const PointSet> colors;
+  if (!load_coreset_path.empty()) {
+    auto coreset = load_coreset(load_coreset_path, working_color_space, storage);
+
+    if (!coreset.has_value()) {
+      std::cerr << "ERROR: Could not load coreset: \"" << load_coreset_path << "\"" << std::endl;
+      return 1;
+    }
+
+    colors = std::make_shared<const PointSet>(std::move(coreset.value()));
+  } else if (quantizer == PaletteQuantizer::None || refine_iterations > 0) {
+    if (histogram) {
+      colors = std::make_shared<const PointSet>(
+          PointSet::fromHistogram(*histogram, working_color_space, storage, accuracy));
+    } else if (num_samples > 0) {
+      colors = std::make_shared<const PointSet>(PointSet::fromImageStratified(
+          image, working_color_space, !dont_skip_black, num_samples, rng, storage, accuracy));
+    } else {
+      colors = std::make_shared<const PointSet>(
+          PointSet::fromImage(image, working_color_space, !dont_skip_black, storage, accuracy));
+    }
+
+    if (coreset_size > 0) {
+      ThreadPool coreset_pool{num_threads};
+      colors = std::make_shared<const PointSet>(
+          build_coreset(*colors, auto_num_clusters ? max_clusters : num_clusters, coreset_size,
+                        rng, coreset_pool));
+
+      std::cout << "Coreset of " << colors->size() << " colors\n";
+    }
+  }
+
+  if (!save_coreset_path.empty() && (!colors || !save_coreset(*colors, save_coreset_path))) {
+    std::cerr << "ERROR: Failed to save coreset!" << std::endl;
+    return 1;
+  }
+
+  const auto run_clustering = [&](KMeansClustering& clustering) {
+    return minibatch_size > 0 ? clustering.run_minibatch(minibatch_size, num_iterations, tolerance,
+                                                         minibatch_final_pass)
+                              : clustering.run(num_iterations, tolerance, min_moved_fraction);
+  };
+
+  std::vector<Color> clusters;
 
   std::cout << "Clustering...\n";
-  clustering.run(num_iterations);
+
+  if (quantizer != PaletteQuantizer::None) {
+    if (quantizer == PaletteQuantizer::Octree) {
+      clusters = octree->palette(num_clusters);
+    } else if (quantizer == PaletteQuantizer::Wu) {
+      clusters = wu_palette(*histogram, num_clusters);
+    } else {
+      clusters = median_cut_palette(*histogram, num_clusters);
+    }
+    num_clusters = clusters.size();
+
+    if (refine_iterations > 0) {
+      KMeansClustering clustering{rng, colors, num_clusters, ClusteringAlgorithm::Lloyd,
+                                  SeedingMethod::Random, num_threads};
+      clustering.set_clusters(clusters);
+
+      const auto iterations_used =
+          clustering.run(refine_iterations, tolerance, min_moved_fraction);
+      clusters = clustering.get_clusters();
+
+      std::cout << "Refinement finished after " << iterations_used << " iterations\n";
+    }
+  } else if (auto_num_clusters) {
+    // Every candidate starts from the previous solution with its worst cluster split in two, so
+    // each one only needs a few iterations to converge
+    KMeansClustering clustering{rng, colors, 1, algorithm, seeding, num_threads};
+
+    std::vector<std::vector<Color>> candidates;
+    std::vector<double> inertias;
+    std::vector<double> silhouettes;
+
+    for (size_t k = 1; k <= max_clusters; ++k) {
+      const auto iterations_used = run_clustering(clustering);
+
+      inertias.push_back(clustering.compute_inertia());
+      silhouettes.push_back(use_silhouette ? clustering.compute_silhouette(silhouette_samples)
+                                           : 0.0);
+      candidates.push_back(clustering.get_clusters());
+
+      std::cout << "K = " << clustering.num_clusters() << ": " << iterations_used
+                << " iterations, inertia " << inertias.back();
+      if (use_silhouette) {
+        std::cout << ", silhouette " << silhouettes.back();
+      }
+      std::cout << "\n";
+
+      if (k < max_clusters && !clustering.split_worst_cluster()) {
+        break;
+      }
+    }
+
+    const auto best_idx = use_silhouette ? select_by_silhouette(silhouettes)
+                                         : select_by_elbow(inertias);
+    clusters = candidates[best_idx];
+    num_clusters = clusters.size();
+
+    std::cout << "Selected " << num_clusters << " clusters\n";
+  } else {
+    // Restarts run concurrently and split the threads between them. The first one uses the main
+    // generator, so a single run gives the same palette as before restarts existed.
+    const auto num_concurrent_restarts = std::max<size_t>(1, std::min(num_restarts, num_threads));
+    const auto threads_per_restart = std::max<size_t>(1, num_threads / num_concurrent_restarts);
+
+    std::vector<RNG> restart_rngs{rng};
+    for (size_t restart_idx = 1; restart_idx < num_restarts; ++restart_idx) {
+      restart_rngs.emplace_back(rng.getIndex(std::numeric_limits<uint32_t>::max()));
+    }
+
+    std::vector<std::vector<Color>> restart_clusters(num_restarts);
+    std::vector<double> restart_inertias(num_restarts);
+    std::vector<size_t> restart_iterations(num_restarts);
+
+    // The kd-tree is read-only, all restarts share one instead of building a copy each
+    std::shared_ptr<const KdTree> kd_tree;
+    if (algorithm == ClusteringAlgorithm::KdTree && num_restarts > 1) {
+      kd_tree = std::make_shared<const KdTree>(*colors);
+    }
+
+    ThreadPool restart_pool{num_concurrent_restarts};
+    restart_pool.parallel_for(num_restarts, [&](size_t, size_t begin, size_t end) {
+      for (size_t restart_idx = begin; restart_idx < end; ++restart_idx) {
+        KMeansClustering clustering{restart_rngs[restart_idx], colors, num_clusters, algorithm,
+                                    seeding, threads_per_restart, kd_tree};
+
+        restart_iterations[restart_idx] = run_clustering(clustering);
+        restart_clusters[restart_idx] = clustering.get_clusters();
+
+        // Restarts are compared by the inertia gathered during their last iteration, only runs
+        // without a full iteration (e.g. mini-batch without a final pass) need another pass
+        if (num_restarts > 1) {
+          const auto inertia = clustering.last_inertia();
+          restart_inertias[restart_idx] = inertia ? *inertia : clustering.compute_inertia();
+        }
+      }
+    });
+
+    const auto best_restart = std::min_element(restart_inertias.begin(), restart_inertias.end());
+    const auto best_restart_idx = static_cast<size_t>(best_restart - restart_inertias.begin());
+    clusters = restart_clusters[best_restart_idx];
+    // Seeding can find fewer distinct centers than requested
+    num_clusters = clusters.size();
+
+    std::cout << "Clustering finished after " << restart_iterations[best_restart_idx]
+              << " iterations\n";
+
+    if (num_restarts > 1) {
+      std::cout << "Best of " << num_restarts << " restarts: " << best_restart_idx + 1
+                << " (inertia " << restart_inertias[best_restart_idx] << ")\n";
+    }
+  }
 
   std::cout << "Saving swatches...\n";
 
@@ -101,26 +598,60 @@ int main(int argc, char** argv) {
   const int palette_image_width = image.getWidth() + 2 * padding;
   const int palette_image_height = image.getHeight() + swatch_height + 3 * padding;
 
-  Image palette_image(palette_image_width, palette_image_height);
+  // Same color space as the input, so it is copied without conversion and a linear preview is
+  // encoded to sRGB with table lookups while saving
+  Image palette_image(palette_image_width, palette_image_height, image.getColorSpace());
   palette_image.clear(bg_color);
 
   palette_image.drawImage(image, padding, padding);
 
-  std::cout << "Clusters:\n";
-  auto clusters = clustering.get_clusters();
+  // Cluster centers in planar form for the batch color conversions below
+  const auto to_planar = [](const std::vector<Color>& colors, std::vector<float>& c0,
+                            std::vector<float>& c1, std::vector<float>& c2) {
+    c0.clear();
+    c1.clear();
+    c2.clear();
+
+    for (const auto& color : colors) {
+      c0.push_back(color.r);
+      c1.push_back(color.g);
+      c2.push_back(color.b);
+    }
+  };
+
+  const auto cluster_color_space =
+      clusters.empty() ? ColorSpace::sRGB : clusters.front().getColorSpace();
+  std::vector<float> c0;
+  std::vector<float> c1;
+  std::vector<float> c2;
 
+  std::cout << "Clusters:\n";
   if (sort_colors) {
-    std::sort(clusters.begin(), clusters.end(), [](const Color& color1, const Color& color2) {
-      const auto c1_oklab = color1.convertTo(ColorSpace::OKLAB);
-      const auto c2_oklab = color2.convertTo(ColorSpace::OKLAB);
-
-      const auto h1 = 0.5f + 0.5f * atan2f(-c1_oklab.g, -c1_oklab.b) / 3.14159265358979323846f;
-      const auto h2 = 0.5f + 0.5f * atan2f(-c2_oklab.g, -c2_oklab.b) / 3.14159265358979323846f;
-
-      return std::less<float>()(h1, h2);
-    });
+    to_planar(clusters, c0, c1, c2);
+    convert_colors(cluster_color_space, ColorSpace::OKLAB, c0.data(), c1.data(), c2.data(),
+                   clusters.size());
+
+    std::vector<std::pair<float, Color>> hues_and_clusters;
+    for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
+      const auto hue =
+          0.5f + 0.5f * atan2f(-c1[cluster_idx], -c2[cluster_idx]) / 3.14159265358979323846f;
+      hues_and_clusters.emplace_back(hue, clusters[cluster_idx]);
+    }
+
+    std::sort(hues_and_clusters.begin(), hues_and_clusters.end(),
+              [](const auto& entry1, const auto& entry2) {
+                return std::less<float>()(entry1.first, entry2.first);
+              });
+
+    for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
+      clusters[cluster_idx] = hues_and_clusters[cluster_idx].second;
+    }
   }
 
+  to_planar(clusters, c0, c1, c2);
+  convert_colors(cluster_color_space, ColorSpace::sRGB, c0.data(), c1.data(), c2.data(),
+                 clusters.size());
+
   for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
     const int swatch_x = std::ceil(padding + cluster_idx * (swatch_width + padding));
     const int swatch_x2 =
@@ -131,7 +662,7 @@ int main(int argc, char** argv) {
 
     const int swatch_y = 2 * padding + image.getHeight();
 
-    const auto swatch_color = clusters[cluster_idx].convertTo(ColorSpace::sRGB);
+    const Color swatch_color{c0[cluster_idx], c1[cluster_idx], c2[cluster_idx]};
 
     palette_image.drawRectangle(swatch_color, swatch_x, swatch_y, adjusted_width, swatch_height);
     std::cout << swatch_color << std::endl;